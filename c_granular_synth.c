@@ -12,20 +12,29 @@
  * @todo Incorporate pointers to previous grains <br>
  * Define maximum grain scheduling as grain density <br>
  * Smoothen output buffer values when grains overlap <br>
- * Incorporate more windowing functions apart from Gauss <br>
  * Pitch detection of samples <br>
  */
 
+#include <string.h>
 #include "c_granular_synth.h"
 #include "envelope.h"
 #include "grain.h"
 #include "purple_utils.h"
 
+static void c_granular_synth_worker_job(void *owner);
+static void c_granular_synth_grain_table_job(c_granular_synth *x);
+static void c_granular_synth_request_window(c_granular_synth *x);
+static void c_granular_synth_publish_window(c_granular_synth *x);
+static void c_granular_synth_prefetch(c_granular_synth *x);
+static void c_granular_synth_advance_modulation(c_granular_synth *x, int num_samples);
+static float c_granular_synth_ramp(c_granular_synth *x, enum synth_ramp r, int k);
+static void c_granular_synth_play_fading_grains(c_granular_synth *x);
+static void c_granular_synth_follow_ramps(c_granular_synth *x, int k);
+
 /**
  * @brief initial setup of soundfile and adjustment silder related variables
  * @details initial setup of soundfile and adjustment silder related variables <br>
- * @param soundfile contains the soundfile which can be read in via inlet <br> 
- * @param soundfile_length length of the soundfile in samples <br> 
+ * @param buffer soundfile the grains read, the synth takes over the reference acquired from the sample buffer cache <br>
  * @param grain_size_ms size of a grain in milliseconds, adjustable through slider <br> 
  * @param start_pos position within the soundfile, adjustable through slider <br> 
  * @param time_stretch_factor resizes sample length within a grain, for negative values read samples in backwards direction, adjustable through slider <br> 
@@ -34,47 +43,111 @@
  * @param sustain sustain time in the range of 0 - 1, adjustable through slider <br> 
  * @param release release time in the range of 0 - 10000ms, adjustable through slider <br> 
  * @param gauss_q_factor used to manipulate grain envelope slope in the range of 0.01 - 1, adjustable through slider<br>
- * @param spray_input randomizes the start position of each grain, actual starting position offset (initally set to 0) calculated on the run <br>
+ * @param spray_input randomizes the start position of each grain <br>
  * @param pitch_factor scaled by pitch/key value given by MIDI input <br>
  * @param midi_pitch MIDI input pitch/key value, usable through virtual or external MIDI device <br>
- * @return c_granular_synth* 
+ * @param scheduler grain scheduler, either the grain table laid out over the soundfile or the density based scheduler <br>
+ * @param grain_density grains per second started by the density based scheduler <br>
+ * @param num_voices number of voices for polyphonic playback <br>
+ * @param window_shape shape of the grain window <br>
+ * @param interpolation interpolation between the samples of the soundfile <br>
+ * @return c_granular_synth*, NULL if its memory could not be reserved, the reference to @a buffer is released then 
  */
-c_granular_synth *c_granular_synth_new(t_word *soundfile, int soundfile_length, int grain_size_ms, t_int start_pos, float time_stretch_factor, int attack, int decay, float sustain, int release, float gauss_q_factor, int spray_input, float pitch_factor, int midi_pitch)
+c_granular_synth *c_granular_synth_new(sample_buffer *buffer, int grain_size_ms, t_int start_pos, float time_stretch_factor, int attack, int decay, float sustain, int release, float gauss_q_factor, int spray_input, float pitch_factor, int midi_pitch, enum grain_scheduler scheduler, float grain_density, int num_voices, enum window_shape window_shape, enum interpolation interpolation)
 {
     c_granular_synth *x = (c_granular_synth *)malloc(sizeof(c_granular_synth));
-    x->soundfile_length = soundfile_length;
+    if(!x)
+    {
+        sample_buffer_release(buffer);
+        return NULL;
+    }
+    x->buffer = buffer;
+    x->soundfile_length = buffer->length;
     x->sr = sys_getsr();
     x->grain_size_ms = grain_size_ms;
     x->grain_size_samples = get_samples_from_ms(x->grain_size_ms, x->sr);
-    x->soundfile_table = (float *) malloc(x->soundfile_length * sizeof(float));
     x->time_stretch_factor = time_stretch_factor;
-    x->midi_pitch = midi_pitch;
     x->pitch_factor =  time_stretch_factor * (float)midi_pitch/48.0;
+    
+    // the grain tables hold the current layout, the worker thread grows them when a later layout needs more grains
+    c_granular_synth_set_num_grains(x);
+    x->grains_table_capacity = x->num_grains;
+    x->shadow_grains_table_capacity = x->num_grains;
+    x->grains_table = (grain *) malloc(x->grains_table_capacity * sizeof(grain));
+    x->shadow_grains_table = (grain *) malloc(x->shadow_grains_table_capacity * sizeof(grain));
+    
+    // everything else the dsp routine touches is reserved here, later parameter changes only reuse this memory
+    if(!purple_arena_init(&x->arena,
+                          purple_arena_aligned_size(sizeof(envelope)) +
+                          2 * window_arena_size(WINDOW_TABLE_SIZE)) || !x->grains_table || !x->shadow_grains_table)
+    {
+        purple_arena_release(&x->arena);
+        free(x->grains_table);
+        free(x->shadow_grains_table);
+        free(x);
+        sample_buffer_release(buffer);
+        return NULL;
+    }
     x->reverse_playback = (x->pitch_factor < 0);
     x->output_buffer = 0.0;
     x->current_start_pos = start_pos;
-    x->sprayed_start_pos = start_pos;
+    x->cycle_start_pos = start_pos;
     x->current_grain_index = 0;
-    x->current_gauss_stage_index = 0;
     x->spray_input = spray_input;
-    x->spray_true_offset = 0;
+    x->gauss_q_factor = gauss_q_factor;
+    x->window_shape = window_shape;
+    x->interpolation = interpolation;
+    grain_kernel_init();
+    x->grain_window = window_new(&x->arena, window_shape, gauss_q_factor, WINDOW_TABLE_SIZE);
+    x->shadow_window = window_new(&x->arena, window_shape, gauss_q_factor, WINDOW_TABLE_SIZE);
+    atomic_init(&x->ready_window, NULL);
+    x->window_building = false;
+    x->window_outdated = false;
+    x->scheduler = scheduler;
     c_granular_synth_adjust_current_grain_index(x);
     
     c_granular_synth_reset_playback_position(x);
     
-    x->current_adsr_stage_index = 0;
-    x->adsr_env = envelope_new(attack, decay, sustain, release);
+    x->adsr_env = envelope_new(&x->arena, attack, decay, sustain, release);
+    x->note_counter = 0;
+    x->render_span = grain_kernel_select();
+    for(int m = 0; m < NUM_MODULATIONS; m++)
+    {
+        x->modulation[m] = NULL;
+    }
+    x->block_index = 0;
+    purple_ramp_jump(&x->ramps[RAMP_START_POS], start_pos);
+    purple_ramp_jump(&x->ramps[RAMP_GRAIN_SIZE], grain_size_ms);
+    purple_ramp_jump(&x->ramps[RAMP_TIME_STRETCH], time_stretch_factor);
+    for(int r = 0; r < NUM_RAMPS; r++)
+    {
+        x->ramp_samples[r] = 0;
+    }
+    for(int i = 0; i < MAX_VOICES; i++)
+    {
+        voice_init(&x->voices[i], midi_pitch, time_stretch_factor);
+    }
+    c_granular_synth_set_num_voices(x, num_voices);
+    c_granular_synth_set_grain_density(x, grain_density);
 
     c_granular_synth_set_num_grains(x);
     c_granular_synth_adjust_current_grain_index(x);
     
-    for(int i = 0; i<soundfile_length;i++)
-    {
-        x->soundfile_table[i] = soundfile[i].w_float;
-    }
+    x->previous_buffer = NULL;
+    x->crossfade_remaining = 0;
     
-    x->grains_table = NULL;
-    c_granular_synth_populate_grain_table(x);
+    x->grains_table_valid = false;
+    x->grains_table_building = false;
+    x->grains_table_outdated = false;
+    x->samples_since_table_request = 0;
+    atomic_init(&x->ready_grains_table, NULL);
+    atomic_init(&x->grains_table_job, false);
+    atomic_init(&x->window_job, false);
+    x->next_scheduled_grain = NULL;
+    grain_pool_clear(&x->active_grains);
+    grain_pool_clear(&x->fading_grains);
+    if(x->scheduler == SCHEDULE_TABLE) c_granular_synth_populate_grain_table(x);
+    purple_worker_start(&x->worker, c_granular_synth_worker_job, x);
 
     return x;
 }
@@ -85,7 +158,7 @@ c_granular_synth *c_granular_synth_new(t_word *soundfile, int soundfile_length,
  * @author Strobl, Micha 
  * @author Wennemann,Tim <br>
  * @brief main synthesizer process
- * @details refreshs plaback positions, starts grain scheduleing, sets gauss value, generates ADSR value according to current state <br>
+ * @details takes over a grain table built by the worker thread and tells a streamed soundfile which region to load. The density based scheduler renders the output in blocks of @a GRAIN_BLOCK_SIZE samples, the grain table is played sample by sample: generates the ADSR value of the voice, refreshs plaback positions and starts grain scheduleing. Every grain is windowed on its own and weighted by the ADSR value of its voice while it is summed up <br>
  * @param x input pointer of @a c_granular_synth_process object <br>
  * @param in input pointer of @a c_granular_synth_process object <br>
  * @param out output pointer of @a c_granular_synth_process object <br>
@@ -95,80 +168,134 @@ c_granular_synth *c_granular_synth_new(t_word *soundfile, int soundfile_length,
 void c_granular_synth_process(c_granular_synth *x, float *in, float *out, int vector_size)
 {
     int i = vector_size;
-    float gauss_val, adsr_val;
+    int num_voices = c_granular_synth_playable_voices(x);
+    
+    c_granular_synth_publish_grain_table(x);
+    c_granular_synth_publish_window(x);
+    c_granular_synth_prefetch(x);
+    sample_buffer_begin_read(x->buffer);
+    sample_buffer_begin_read(x->previous_buffer);
+    x->block_index = 0;
+    
+    if(x->scheduler == SCHEDULE_DENSITY)
+    {
+        for(int offset = 0; offset < vector_size; offset += GRAIN_BLOCK_SIZE)
+        {
+            int length = vector_size - offset;
+            c_granular_synth_render_density(x, out + offset, (length < GRAIN_BLOCK_SIZE) ? length : GRAIN_BLOCK_SIZE);
+        }
+        sample_buffer_end_read(x->buffer);
+        sample_buffer_end_read(x->previous_buffer);
+        c_granular_synth_advance_modulation(x, vector_size);
+        return;
+    }
     
      while(i--)
     {
         x->output_buffer = 0;
         
-        if(x->spray_input != 0 && x->spray_true_offset == 0 && x->midi_velo != 0)
+        for(int v = 0; v < num_voices; v++)
         {
-            x->spray_true_offset = spray_dependant_playback_nudge(x->spray_input);
-            if(x->spray_true_offset != 0)
-            {     
-                c_granular_synth_reset_playback_position(x);
-                c_granular_synth_adjust_current_grain_index(x);
-                c_granular_synth_populate_grain_table(x);
-            }
+            voice_next_adsr_value(&x->voices[v], x->adsr_env);
         }
-        else
+        
+        x->playback_position++;
+        if(x->playback_position >= x->soundfile_length)
         {
-            x->playback_position++;
-            if(x->playback_position >= x->soundfile_length)
-            {
-                x->playback_position = 0;
-            }
-            else if(x->playback_position < 0)
-            {
-                x->playback_position = x->soundfile_length - 1 + x->playback_position;
-            }
-            else if(x->playback_position >= x->playback_cycle_end)
-            {
-                x->playback_position = x->current_start_pos;
-            }
+            x->playback_position = 0;
         }
-
-        grain_internal_scheduling(&x->grains_table[x->current_grain_index], x);
-        
-        gauss_val = gauss(x);
-        x->output_buffer *= gauss_val;
-        
-        if(x->midi_velo > 0)
+        else if(x->playback_position < 0)
         {
-            adsr_val = calculate_adsr_value(x);
+            x->playback_position = x->soundfile_length - 1 + x->playback_position;
         }
-        else
+        else if(x->playback_position >= x->playback_cycle_end)
         {
-            if(x->adsr_env->adsr == SILENT)
-            {
-                adsr_val = 0;
-            }
-            else
-            {
-                if(x->adsr_env->adsr != RELEASE)
-                {
-                    x->current_adsr_stage_index = 0;
-                    x->adsr_env->adsr = RELEASE;
-                }
-                adsr_val = calculate_adsr_value(x);
-            }
+            x->playback_position = x->current_start_pos;
         }
-        x->output_buffer *= adsr_val;
+
+        if(x->grains_table_building) x->samples_since_table_request++;
+        if(x->grains_table_valid && c_granular_synth_schedule_grains(x)) c_granular_synth_follow_ramps(x, x->block_index);
+        if(x->fading_grains.num_active > 0) c_granular_synth_play_fading_grains(x);
+        if(x->crossfade_remaining > 0) x->crossfade_remaining--;
+        x->block_index++;
+        
         *out++ = x->output_buffer;
     }
+    sample_buffer_end_read(x->buffer);
+    sample_buffer_end_read(x->previous_buffer);
+    c_granular_synth_advance_modulation(x, vector_size);
+    for(int r = 0; r < NUM_RAMPS; r++)
+    {
+        purple_ramp_advance(&x->ramps[r], vector_size);
+    }
+}
+/**
+ * @brief hands a signal to a parameter
+ * @details the signal is read from the sample rendered next on and added to the parameter whenever the density based scheduler starts a grain, so the grain table is never rebuilt for it.
+ * Every call of @a c_granular_synth_process moves on by the samples it rendered <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param m the modulated parameter <br>
+ * @param signal samples of the signal, NULL stops the modulation <br>
+ */
+void c_granular_synth_set_modulation(c_granular_synth *x, enum synth_modulation m, const float *signal)
+{
+    x->modulation[m] = signal;
+}
+/**
+ * @brief moves the signals on
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param num_samples number of samples rendered <br>
+ */
+static void c_granular_synth_advance_modulation(c_granular_synth *x, int num_samples)
+{
+    for(int m = 0; m < NUM_MODULATIONS; m++)
+    {
+        if(x->modulation[m]) x->modulation[m] += num_samples;
+    }
+}
+/**
+ * @brief reads a signal
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param m the modulated parameter <br>
+ * @param k sample of the block rendered by the density based scheduler <br>
+ * @return value of the signal, 0 if the parameter is not modulated or the signal is not finite <br>
+ */
+static float c_granular_synth_modulation(c_granular_synth *x, enum synth_modulation m, int k)
+{
+    float value = x->modulation[m] ? x->modulation[m][x->block_index + k] : 0;
+    return isfinite(value) ? value : 0;
+}
+/**
+ * @brief tells the soundfile which region the grains are going to read
+ * @details the grains start within the spray range around @a current_start_pos and read as far as a grain at the fastest pitch factor of the sounding voices reaches in either direction, the grain table starts backwards grains one grain later <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+static void c_granular_synth_prefetch(c_granular_synth *x)
+{
+    float rate = fabsf(x->pitch_factor);
+    int num_voices = c_granular_synth_playable_voices(x);
+    int reach;
     
+    for(int v = 0; v < num_voices; v++)
+    {
+        if(voice_is_sounding(&x->voices[v]) && fabsf(x->voices[v].pitch_factor) > rate) rate = fabsf(x->voices[v].pitch_factor);
+    }
+    reach = abs(x->spray_input) + x->grain_size_samples + (int)ceilf(x->grain_size_samples * rate);
+    sample_buffer_prefetch(x->buffer, x->current_start_pos - reach, x->current_start_pos + reach, x->current_start_pos);
 }
 
 /**
  * @author Kretschmar, Nikita 
  * @author Philipp, Adrian <br>
  * @brief sets number of grains
- * @details sets number of grains according to @a soundfile_length and @a grain_size_samples <br>
+ * @details sets number of grains according to @a soundfile_length and @a grain_size_samples, limited to @a GRAIN_TABLE_CAPACITY <br>
  * @param x input pointer of @a c_granular_synth_set_num_grains object <br>
  */
 void c_granular_synth_set_num_grains(c_granular_synth *x)
 {
     x->num_grains = (int)ceilf(fabsf(x->soundfile_length * x->pitch_factor) / x->grain_size_samples);
+    if(x->num_grains > GRAIN_TABLE_CAPACITY) x->num_grains = GRAIN_TABLE_CAPACITY;
+    if(x->num_grains < 1) x->num_grains = 1;
 }
 /**
  * @author Strobl, Micha 
@@ -181,151 +308,882 @@ void c_granular_synth_adjust_current_grain_index(c_granular_synth *x)
 {
     if(x->num_grains > 0)
     {
-        int index = ceil((x->sprayed_start_pos * fabs(x->pitch_factor)) / x->grain_size_samples);
+        int index = ceil((x->cycle_start_pos * fabs(x->pitch_factor)) / x->grain_size_samples);
         x->current_grain_index = (index == 0) ? 0 : index % x->num_grains;
     }
 }
 /**
  * @author Philipp, Adrian 
  * @author Strobl, Micha <br>
- * @brief generates a grain table
- * @details generates a grain table according to @a current_grain_index, for negative @a time_stretch_factor values samples are read in backwards direction <br>
- * @param x input pointer of @a c_granular_synth_populate_grain_table object <br>
+ * @brief builds a grain table
+ * @details lays out the grains of @a r starting at @a current_grain_index, for negative @a time_stretch_factor values samples are read in backwards direction.
+ * Only reads @a r, so it runs on the worker thread while the dsp routine keeps playing the current table <br>
+ * @param grains_table table of the arena the grains are written to <br>
+ * @param r parameters of the table <br>
  */
-void c_granular_synth_populate_grain_table(c_granular_synth *x)
+static void c_granular_synth_build_grain_table(grain *grains_table, grain_table_request *r)
 {
-    grain *grains_table;
-    grains_table = (grain *) calloc(x->num_grains, sizeof(grain));
+    memset(grains_table, 0, r->num_grains * sizeof(grain));
     int j;
     float start_offset = 0;
     
-    if(x->reverse_playback)
+    if(r->reverse_playback)
     {
-        for(j = x->current_grain_index; j >= 0; j--)
+        for(j = r->current_grain_index; j >= 0; j--)
         {
             
-            grains_table[j] = grain_new(x->grain_size_samples,
-                                        x->soundfile_length,
-                                        (x->sprayed_start_pos + x->grain_size_samples + start_offset),
-                                        j, x->pitch_factor);
-            if(j < x->current_grain_index) grains_table[j+1].next_grain = &grains_table[j];
+            grains_table[j] = grain_new(r->grain_size_samples,
+                                        r->soundfile_length,
+                                        (r->start_pos + r->grain_size_samples + start_offset),
+                                        j, r->pitch_factor);
+            if(j < r->current_grain_index) grains_table[j+1].next_grain = &grains_table[j];
 
-            start_offset += x->pitch_factor * x->grain_size_samples;
+            start_offset += r->pitch_factor * r->grain_size_samples;
         }
-        grains_table[0].next_grain = &grains_table[x->num_grains - 1];
+        grains_table[0].next_grain = &grains_table[r->num_grains - 1];
     }
     else
     {
-        for(j = x->current_grain_index; j<x->num_grains; j++)
+        for(j = r->current_grain_index; j<r->num_grains; j++)
         {
-            grains_table[j] = grain_new(x->grain_size_samples,
-                                        x->soundfile_length,
-                                        (x->sprayed_start_pos + start_offset),
-                                        j, x->pitch_factor);
+            grains_table[j] = grain_new(r->grain_size_samples,
+                                        r->soundfile_length,
+                                        (r->start_pos + start_offset),
+                                        j, r->pitch_factor);
             if(j > 0) grains_table[j-1].next_grain = &grains_table[j];
 
-            start_offset += x->pitch_factor * x->grain_size_samples;
+            start_offset += r->pitch_factor * r->grain_size_samples;
         }
-        grains_table[x->num_grains - 1].next_grain = &grains_table[0];
+        grains_table[r->num_grains - 1].next_grain = &grains_table[0];
     }
+}
+/**
+ * @brief collects the parameters of the next grain table
+ * @details the playing table keeps @a num_grains and @a current_grain_index until the next table is published <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param r parameters of the next table <br>
+ */
+static void c_granular_synth_describe_grain_table(c_granular_synth *x, grain_table_request *r)
+{
+    int num_grains = x->num_grains;
+    int current_grain_index = x->current_grain_index;
     
-    c_granular_synth_reset_playback_position(x);
+    c_granular_synth_set_num_grains(x);
+    c_granular_synth_adjust_current_grain_index(x);
+    r->num_grains = x->num_grains;
+    r->current_grain_index = x->current_grain_index;
+    r->grain_size_samples = x->grain_size_samples;
+    r->start_pos = x->cycle_start_pos;
+    r->pitch_factor = x->pitch_factor;
+    r->reverse_playback = x->reverse_playback;
+    r->soundfile_length = x->soundfile_length;
+    
+    x->num_grains = num_grains;
+    x->current_grain_index = current_grain_index;
+}
+/**
+ * @brief makes room for a grain table in the shadow table
+ * @details runs where the table is built, never in the dsp routine. A shadow table that is too small for @a r grows at least to twice its size, so a glide does not grow it for every table, and at most to @a GRAIN_TABLE_CAPACITY grains.
+ * If the memory cannot be had the layout is cut to the grains the shadow table holds <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param r parameters of the table <br>
+ */
+static void c_granular_synth_reserve_grain_table(c_granular_synth *x, grain_table_request *r)
+{
+    int capacity = x->shadow_grains_table_capacity;
+    grain *grown;
     
-    if(x->grains_table) free(x->grains_table);
+    if(r->num_grains <= capacity) return;
+    capacity = (capacity * 2 > r->num_grains) ? capacity * 2 : r->num_grains;
+    if(capacity > GRAIN_TABLE_CAPACITY) capacity = GRAIN_TABLE_CAPACITY;
+    grown = (grain *) malloc(capacity * sizeof(grain));
+    if(grown)
+    {
+        free(x->shadow_grains_table);
+        x->shadow_grains_table = grown;
+        x->shadow_grains_table_capacity = capacity;
+        return;
+    }
+    r->num_grains = x->shadow_grains_table_capacity;
+    r->current_grain_index %= r->num_grains;
+}
+/**
+ * @brief makes a built grain table the playing one
+ * @details the previous table becomes the shadow table. Its playing grains are handed to @a fading_grains, which play to the end of their window without referencing the table.
+ * The new table starts its cycle over, so the grains that started after it was requested, like the grain restarted at the end of the cycle that requested it, are dropped instead of playing twice <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param grains_table the built table <br>
+ * @param r parameters the table was built from <br>
+ */
+static void c_granular_synth_install_grain_table(c_granular_synth *x, grain *grains_table, grain_table_request *r)
+{
+    int capacity = x->grains_table_capacity;
+    
+    x->grains_table_capacity = x->shadow_grains_table_capacity;
+    x->shadow_grains_table_capacity = capacity;
+    x->shadow_grains_table = x->grains_table;
     x->grains_table = grains_table;
+    x->num_grains = r->num_grains;
+    x->current_grain_index = r->current_grain_index;
+    
+    c_granular_synth_reset_playback_position(x);
+    
+    grain_pool_take_over(&x->fading_grains, &x->active_grains, x->soundfile_length, x->samples_since_table_request);
+    x->grains_table_valid = true;
+    x->next_scheduled_grain = NULL;
+}
+/**
+ * @brief builds the requested grain table
+ * @details builds @a table_request into the shadow table and hands it to the dsp routine <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+static void c_granular_synth_grain_table_job(c_granular_synth *x)
+{
+    c_granular_synth_reserve_grain_table(x, &x->table_request);
+    c_granular_synth_build_grain_table(x->shadow_grains_table, &x->table_request);
+    atomic_store_explicit(&x->ready_grains_table, x->shadow_grains_table, memory_order_release);
 }
 /**
  * @author Philipp, Adrian 
- * @author Wennemann,Tim <br>
- * @brief checks on current input states
- * @details checks slider positions, MIDI input and ADSR state to update correspondent values <br>
- * @param[in] x input pointer of c_granular_synth_properties_update object <br>
- * @param[in] midi_velo MIDI input velocity value, usable through virtual or external MIDI device, also used for noteon detection <br>
- * @param[in] midi_pitch MIDI input pitch/key value, usable through virtual or external MIDI device<br>
- * @param[in] grain_size_ms size of a grain in milliseconds, adjustable through slider <br>
- * @param[in] start_pos position within the soundfile, adjustable through slider <br>
- * @param[in] time_stretch_factor resizes sample length within a grain, adjustable through slider <br>
- * @param[in] attack attack time in the range of 0 - 4000ms, adjustable through slider <br>
- * @param[in] decay decay time in the range of 0 - 4000ms, adjustable through slider <br>
- * @param[in] sustain sustain time in the range of 0 - 1, adjustable through slider <br>
- * @param[in] release release time in the range of 0 - 10000ms, adjustable through slider <br>
- * @param[in] gauss_q_factor envelope manipulation value in the range of 0.01 - 1, adjustable through slider <br>
- * @param[in] spray_input randomizes the start position of each grain, adjustable through slider <br>
+ * @author Strobl, Micha <br>
+ * @brief generates a grain table
+ * @details generates a grain table according to @a current_grain_index and plays it right away. Blocks until the table is built, so it is only used while no audio is running <br>
+ * @param x input pointer of @a c_granular_synth_populate_grain_table object <br>
+ */
+void c_granular_synth_populate_grain_table(c_granular_synth *x)
+{
+    grain_table_request r;
+    c_granular_synth_describe_grain_table(x, &r);
+    c_granular_synth_reserve_grain_table(x, &r);
+    c_granular_synth_build_grain_table(x->shadow_grains_table, &r);
+    c_granular_synth_install_grain_table(x, x->shadow_grains_table, &r);
+}
+/**
+ * @brief requests a new grain table
+ * @details called by the dsp routine, the table is built on the worker thread and published by @a c_granular_synth_publish_grain_table.
+ * Requests made while a table is being built are merged into one request that follows it.
+ * If the worker thread is not running the table is built right away <br>
+ * @param x input pointer of @a c_granular_synth object <br>
  */
-void c_granular_synth_properties_update(c_granular_synth *x, t_int grain_size_ms, t_int start_pos, float time_stretch_factor, t_int midi_velo, t_int midi_pitch, t_int attack, t_int decay, float sustain, t_int release, float gauss_q_factor, t_int spray_input)
+void c_granular_synth_request_grain_table(c_granular_synth *x)
 {
+    if(x->grains_table_building)
+    {
+        x->grains_table_outdated = true;
+        return;
+    }
+    c_granular_synth_describe_grain_table(x, &x->table_request);
+    x->grains_table_building = true;
+    x->grains_table_outdated = false;
+    x->samples_since_table_request = 0;
     
-    if(x->midi_velo != midi_velo)
+    if(x->worker.running)
     {
-        x->midi_velo = (int)midi_velo;
+        atomic_store(&x->grains_table_job, true);
+        purple_worker_wake(&x->worker);
     }
+    else
+    {
+        c_granular_synth_grain_table_job(x);
+        c_granular_synth_publish_grain_table(x);
+    }
+}
+/**
+ * @brief publishes a built grain table
+ * @details called once per dsp block, takes over the table of the worker thread with a single atomic exchange.
+ * A table that arrives after switching to the density based scheduler is dropped <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+void c_granular_synth_publish_grain_table(c_granular_synth *x)
+{
+    grain *grains_table = atomic_exchange_explicit(&x->ready_grains_table, NULL, memory_order_acquire);
+    if(!grains_table) return;
+    
+    x->grains_table_building = false;
+    if(x->scheduler != SCHEDULE_TABLE) return;
     
-    if(x->midi_pitch != midi_pitch)
+    c_granular_synth_install_grain_table(x, grains_table, &x->table_request);
+    if(x->grains_table_outdated) c_granular_synth_request_grain_table(x);
+}
+/**
+ * @brief fills the requested grain window
+ * @details fills the shadow window with the requested shape and hands it to the dsp routine <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+static void c_granular_synth_window_job(c_granular_synth *x)
+{
+    window_update(x->shadow_window, x->window_request_shape, x->window_request_q);
+    atomic_store_explicit(&x->ready_window, x->shadow_window, memory_order_release);
+}
+/**
+ * @brief job of the worker thread
+ * @details builds every grain table and grain window the dsp routine asked for since the last run <br>
+ * @param owner pointer to the @a c_granular_synth object <br>
+ */
+static void c_granular_synth_worker_job(void *owner)
+{
+    c_granular_synth *x = (c_granular_synth *)owner;
+    if(atomic_exchange(&x->grains_table_job, false)) c_granular_synth_grain_table_job(x);
+    if(atomic_exchange(&x->window_job, false)) c_granular_synth_window_job(x);
+}
+/**
+ * @brief requests a new grain window
+ * @details the window is filled on the worker thread and published by @a c_granular_synth_publish_window, so the grains never read a window that is being filled.
+ * Requests made while a window is being filled are merged into one request that follows it.
+ * If the worker thread is not running the window is filled right away <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+static void c_granular_synth_request_window(c_granular_synth *x)
+{
+    if(x->window_building)
     {
-        x->midi_pitch = (int)midi_pitch;
-        if(x->midi_velo != 0) x->pitch_factor = time_stretch_factor * x->midi_pitch / 48.0;
+        x->window_outdated = true;
+        return;
     }
+    x->window_request_shape = x->window_shape;
+    x->window_request_q = x->gauss_q_factor;
+    x->window_building = true;
+    x->window_outdated = false;
     
-    if(x->grain_size_ms != grain_size_ms ||
-       x->current_start_pos != start_pos ||
-       x->time_stretch_factor != time_stretch_factor ||
-       !x->grains_table)
+    if(x->worker.running)
     {
-        if(x->grain_size_ms != grain_size_ms)
+        atomic_store(&x->window_job, true);
+        purple_worker_wake(&x->worker);
+    }
+    else
+    {
+        c_granular_synth_window_job(x);
+        c_granular_synth_publish_window(x);
+    }
+}
+/**
+ * @brief publishes a filled grain window
+ * @details called once per dsp block, takes over the window of the worker thread with a single atomic exchange. The previous window becomes the shadow window <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+static void c_granular_synth_publish_window(c_granular_synth *x)
+{
+    window *w = atomic_exchange_explicit(&x->ready_window, NULL, memory_order_acquire);
+    if(!w) return;
+    
+    x->shadow_window = x->grain_window;
+    x->grain_window = w;
+    x->window_building = false;
+    if(x->window_outdated) c_granular_synth_request_window(x);
+}
+/**
+ * @brief sprays and modulates a grain of the grain table
+ * @details moves the read position of a grain that is about to start by a random offset within the spray range and by the start position signal, and takes its speed offset from the time stretch signal.
+ * The signals are sampled at the onset like the density based scheduler does. Only this grain is affected, the table and the playback position stay as they are <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param i slot of the grain, nothing happens for -1 <br>
+ */
+static void c_granular_synth_modulate_grain(c_granular_synth *x, int i)
+{
+    grain_pool *pool = &x->active_grains;
+    float spray, offset, speed_offset;
+    
+    if(i < 0) return;
+    spray = fminf(fmaxf(x->spray_input + c_granular_synth_modulation(x, MODULATE_SPRAY, 0) * x->sr / 1000, 0), x->soundfile_length);
+    offset = fmodf(c_granular_synth_modulation(x, MODULATE_START_POS, 0), x->soundfile_length);
+    speed_offset = c_granular_synth_modulation(x, MODULATE_TIME_STRETCH, 0) * x->voices[0].midi_pitch / 48.0;
+    pool->speed_offset[i] = fminf(fmaxf(speed_offset, -x->soundfile_length), x->soundfile_length);
+    if(spray >= 1 || offset != 0)
+    {
+        grain_pool_offset(pool, i, (int)offset + spray_dependant_playback_nudge((int)spray), x->soundfile_length);
+    }
+}
+/**
+ * @brief plays the grains of the previous grain table for one output sample
+ * @details the grains that were playing when a new grain table was taken over keep their position, speed and window and are retired once their window has ended, so the new table starts without cutting off the previous one <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ */
+static void c_granular_synth_play_fading_grains(c_granular_synth *x)
+{
+    grain_pool *pool = &x->fading_grains;
+    int i = 0;
+    
+    while(i < pool->num_active)
+    {
+        if(x->buffer->stream)
         {
-            x->grain_size_ms = (int)grain_size_ms;
-            int grain_size_samples = get_samples_from_ms((int)grain_size_ms, x->sr);
-            x->grain_size_samples = grain_size_samples;
+            int available = sample_buffer_available(x->buffer, pool->position[i], pool->increment[i], STREAM_FADE_SAMPLES);
+            if(available < STREAM_FADE_SAMPLES) grain_pool_fade(pool, i, available);
         }
-        if(x->current_start_pos != start_pos)
+        x->output_buffer += grain_process_sample(pool, i, x);
+        
+        if(pool->remaining[i] <= 0)
+        {
+            grain_pool_retire(pool, i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+/**
+ * @author Strobl, Micha <br>
+ * @brief plays all active grains for one output sample
+ * @details walks the pool of playing grains in start order and sums their samples into @a output_buffer, starts the following grains of the table as soon as the playback position reaches them and retires a grain together with its successors once it falls out of the playback range.
+ * A grain of a streamed soundfile that is about to reach a block that is not loaded fades out and starts over <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @return true if a grain played all of its samples and the grain cycle started over <br>
+ */
+bool c_granular_synth_schedule_grains(c_granular_synth *x)
+{
+    grain_pool *pool = &x->active_grains;
+    grain *g;
+    int i = 0;
+    bool cycle_ended = false;
+    
+    if(pool->num_active == 0)
+    {
+        c_granular_synth_modulate_grain(x, grain_pool_start(pool, &x->grains_table[x->current_grain_index], 0, 0));
+        x->next_scheduled_grain = x->grains_table[x->current_grain_index].next_grain;
+    }
+    
+    while(true)
+    {
+        if(i == pool->num_active)
         {
-            x->current_start_pos = start_pos;
+            g = x->next_scheduled_grain;
+            if(!g || g->grain_index == x->current_grain_index || !grain_is_in_playback_range(g->start, g->end, g->grain_index, x)) break;
+            if(grain_pool_start(pool, g, 0, 0) < 0) break;
+            c_granular_synth_modulate_grain(x, i);
+            x->next_scheduled_grain = g->next_grain;
         }
         
-        if(x->time_stretch_factor != time_stretch_factor)
+        if(!grain_is_in_playback_range(pool->start[i], pool->end[i], pool->grain_index[i], x))
         {
-            x->time_stretch_factor = time_stretch_factor;
-            x->pitch_factor = time_stretch_factor * x->midi_pitch / 48.0;
+            x->next_scheduled_grain = &x->grains_table[pool->grain_index[i]];
+            grain_pool_truncate(pool, i);
+            break;
+        }
+        grain_pool_set_speed(pool, i, x->pitch_factor + pool->speed_offset[i]);
+        if(x->buffer->stream)
+        {
+            int available = sample_buffer_available(x->buffer, pool->position[i], pool->increment[i], STREAM_FADE_SAMPLES);
+            if(available < STREAM_FADE_SAMPLES) grain_pool_fade(pool, i, available);
+        }
+        x->output_buffer += grain_process_sample(pool, i, x);
+        
+        if(pool->remaining[i] <= 0)
+        {
+            grain_pool_restart(pool, i, x->soundfile_length);
+            c_granular_synth_modulate_grain(x, i);
+            c_granular_synth_reset_playback_position(x);
+            cycle_ended = true;
+        }
+        i++;
+    }
+    return cycle_ended;
+}
+/**
+ * @brief renders a span from a sample buffer
+ * @details buffers that read their samples in place have no guard samples and are rendered by the strided kernel, all others by the fastest kernel of the CPU. Streamed buffers render every loaded block like a table <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param b the buffer <br>
+ * @param s span with its length, output, gains and window set <br>
+ * @param position read position of the first sample of the span in the soundfile <br>
+ * @param step advance of the read position per sample <br>
+ * @param rate absolute speed of the grain <br>
+ */
+static void c_granular_synth_render_buffer(c_granular_synth *x, sample_buffer *b, grain_span *s, fixed_position position, fixed_position step, float rate)
+{
+    if(b->stream)
+    {
+        s->position = position;
+        s->step = step;
+        sample_stream_render(b->stream, s, x->render_span);
+        return;
+    }
+    sample_buffer_span(b, s, position, step, rate);
+    if(b->storage == STORAGE_VIEW)
+    {
+        grain_kernel_strided(s);
+    }
+    else
+    {
+        x->render_span(s);
+    }
+}
+/**
+ * @brief density based grain scheduling for one block
+ * @details every sounding voice starts a new grain at @a current_start_pos (nudged by spray) with its own pitch factor whenever its inter-onset interval has passed. The signals in @a modulation are added to the parameters of a grain at its onset.
+ * The ADSR values of the voices and the onsets are worked out sample by sample first, then every playing grain is rendered from its onset to the end of the block by the kernel in @a render_span, weighted by its own window and the ADSR value of its voice.
+ * Grains that read faster than the original speed read the level of the pyramid of @a buffer that matches their pitch factor, backwards grains at the original speed read the reversed copy forwards.
+ * While @a crossfade_remaining runs every grain is rendered from @a previous_buffer and @a buffer with complementary gains.
+ * A grain of a streamed soundfile that would reach a block that is not loaded within @a STREAM_FADE_SAMPLES samples fades out before it gets there.
+ * Grains that played all of their samples are retired. No grain table is needed, memory depends on the number of overlapping grains only <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param out output samples <br>
+ * @param length number of samples, at most @a GRAIN_BLOCK_SIZE <br>
+ */
+void c_granular_synth_render_density(c_granular_synth *x, float *out, int length)
+{
+    grain_pool *pool = &x->active_grains;
+    grain new_grain;
+    voice *v;
+    grain_span span;
+    t_int grain_start_pos;
+    float rate, density, pitch_factor, onset_interval, size, max_size, offset;
+    int i, k, n, grain_size, spray;
+    
+    memset(out, 0, length * sizeof(float));
+    memset(pool->block_offset, 0, pool->num_active * sizeof(int));
+    
+    for(k = 0; k < length; k++)
+    {
+        for(int j = 0; j < x->num_voices; j++)
+        {
+            v = &x->voices[j];
+            x->voice_gains[j][k] = voice_next_adsr_value(v, x->adsr_env);
+            density = x->grain_density + c_granular_synth_modulation(x, MODULATE_DENSITY, k);
+            if(density <= 0 || x->grain_size_samples <= 0 || !voice_is_sounding(v)) continue;
+            
+            v->samples_to_next_onset--;
+            if(v->samples_to_next_onset > 0) continue;
             
+            // the ramps and signals are sampled once per onset and clamped, so no signal value can stall the scheduler
+            size = (x->ramps[RAMP_GRAIN_SIZE].remaining > 0) ? (int)(purple_ramp_value_at(&x->ramps[RAMP_GRAIN_SIZE], k) * x->sr / 1000) : x->grain_size_samples;
+            size += (int)fminf(fmaxf(c_granular_synth_modulation(x, MODULATE_GRAIN_SIZE, k) * x->sr / 1000, -x->soundfile_length), x->soundfile_length);
+            max_size = (x->grain_size_samples > x->soundfile_length) ? x->grain_size_samples : x->soundfile_length;
+            grain_size = (int)fminf(fmaxf(size, 1), max_size);
+            spray = (int)fminf(fmaxf(x->spray_input + c_granular_synth_modulation(x, MODULATE_SPRAY, k) * x->sr / 1000, 0), x->soundfile_length);
+            pitch_factor = (x->ramps[RAMP_TIME_STRETCH].remaining > 0) ? purple_ramp_value_at(&x->ramps[RAMP_TIME_STRETCH], k) * v->midi_pitch / 48.0 : v->pitch_factor;
+            pitch_factor += c_granular_synth_modulation(x, MODULATE_TIME_STRETCH, k) * v->midi_pitch / 48.0;
+            pitch_factor = fminf(fmaxf(pitch_factor, -x->soundfile_length), x->soundfile_length);
+            onset_interval = (density == x->grain_density) ? x->onset_interval_samples : x->sr / density;
+            if(onset_interval < 1) onset_interval = 1;
+            if(onset_interval > x->sr * MAX_ONSET_INTERVAL_SECONDS) onset_interval = x->sr * MAX_ONSET_INTERVAL_SECONDS;
+            offset = fmodf(c_granular_synth_modulation(x, MODULATE_START_POS, k), x->soundfile_length);
+            
+            while(v->samples_to_next_onset <= 0)
+            {
+                grain_start_pos = ((t_int)c_granular_synth_ramp(x, RAMP_START_POS, k) + (t_int)offset + spray_dependant_playback_nudge(spray)) % x->soundfile_length;
+                if(grain_start_pos < 0) grain_start_pos += x->soundfile_length;
+                
+                new_grain = grain_new(grain_size, x->soundfile_length, grain_start_pos, -1, pitch_factor);
+                grain_pool_start(pool, &new_grain, j, k);
+                v->samples_to_next_onset += onset_interval;
+            }
         }
-        c_granular_synth_set_num_grains(x);
-        c_granular_synth_adjust_current_grain_index(x);
-        c_granular_synth_populate_grain_table(x);
     }
     
-    if(x->spray_input != spray_input)
+    span.window_table = x->grain_window->window_samples_table;
+    span.window_resolution = x->grain_window->resolution;
+    span.interpolation = x->interpolation;
+    for(k = 0; k < length; k++)
     {
-        x->spray_input = (int)spray_input;
+        n = x->crossfade_remaining - k;
+        x->crossfade_gains[k] = (n > 0) ? (float)n / BUFFER_CROSSFADE_SAMPLES : 0;
     }
     
-    if (x->adsr_env->attack != attack || x->adsr_env->decay != decay || x->adsr_env->sustain != sustain || x->adsr_env->release != release)
+    i = 0;
+    while(i < pool->num_active)
     {
-        if(x->adsr_env->attack != attack)
+        k = pool->block_offset[i];
+        if(x->buffer->stream)
         {
-            x->adsr_env->attack = (int)attack;
+            int available = sample_buffer_available(x->buffer, pool->position[i], pool->increment[i], length - k + STREAM_FADE_SAMPLES);
+            if(available < length - k + STREAM_FADE_SAMPLES) grain_pool_fade(pool, i, available);
         }
-        if(x->adsr_env->decay != decay)
+        span.length = length - k;
+        if(span.length > pool->remaining[i]) span.length = pool->remaining[i];
+        span.out = out + k;
+        span.voice_gain = x->voice_gains[pool->voice_index[i]] + k;
+        span.window_phase = pool->window_phase[i];
+        span.window_increment = pool->window_increment[i];
+        span.amplitude = pool->amplitude[i];
+        rate = fabsf(pool->time_stretch_factor[i]);
+        if(span.length > 0 && x->crossfade_remaining > k)
         {
-            x->adsr_env->decay = (int)decay;
+            for(n = 0; n < span.length; n++)
+            {
+                x->fade_gains[0][n] = span.voice_gain[n] * x->crossfade_gains[k + n];
+                x->fade_gains[1][n] = span.voice_gain[n] - x->fade_gains[0][n];
+            }
+            span.voice_gain = x->fade_gains[0];
+            c_granular_synth_render_buffer(x, x->previous_buffer, &span, pool->position[i], pool->increment[i], rate);
+            span.voice_gain = x->fade_gains[1];
         }
-        if(x->adsr_env->sustain != sustain)
+        if(span.length > 0)
         {
-            x->adsr_env->sustain = sustain;
+            c_granular_synth_render_buffer(x, x->buffer, &span, pool->position[i], pool->increment[i], rate);
+            grain_pool_advance(pool, i, span.length, x->soundfile_length);
         }
-        if(x->adsr_env->release != release)
+        
+        if(pool->remaining[i] <= 0)
         {
-            x->adsr_env->release = (int)release;
+            grain_pool_retire(pool, i);
+        }
+        else
+        {
+            i++;
         }
-        x->adsr_env = envelope_new(x->adsr_env->attack,
-                                   x->adsr_env->decay,
-                                   x->adsr_env->sustain,
-                                   x->adsr_env->release);
     }
-
-    if(x->gauss_q_factor != gauss_q_factor)
+    
+    x->crossfade_remaining -= length;
+    if(x->crossfade_remaining < 0) x->crossfade_remaining = 0;
+    x->block_index += length;
+    for(int r = 0; r < NUM_RAMPS; r++)
+    {
+        purple_ramp_advance(&x->ramps[r], length);
+    }
+    c_granular_synth_follow_ramps(x, 0);
+}
+/**
+ * @brief sets the grain density
+ * @details sets the number of grains per second started by the density based scheduler and derives the inter-onset interval from it <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param grain_density grains per second, values <= 0 stop starting new grains <br>
+ */
+void c_granular_synth_set_grain_density(c_granular_synth *x, float grain_density)
+{
+    x->grain_density = grain_density;
+    if(grain_density <= 0) return;
+    
+    x->onset_interval_samples = x->sr / grain_density;
+    if(x->onset_interval_samples < 1) x->onset_interval_samples = 1;
+    for(int i = 0; i < MAX_VOICES; i++)
+    {
+        if(x->voices[i].samples_to_next_onset > x->onset_interval_samples) x->voices[i].samples_to_next_onset = x->onset_interval_samples;
+    }
+}
+/**
+ * @brief number of voices the active scheduler can play
+ * @details the grain table is laid out for a single pitch factor, so it plays one voice only <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @return number of usable voices <br>
+ */
+int c_granular_synth_playable_voices(c_granular_synth *x)
+{
+    return (x->scheduler == SCHEDULE_TABLE) ? 1 : x->num_voices;
+}
+/**
+ * @brief sets the number of voices
+ * @details voices beyond the new number are silenced immediately <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param num_voices number of voices in the range of 1 - @a MAX_VOICES <br>
+ */
+void c_granular_synth_set_num_voices(c_granular_synth *x, int num_voices)
+{
+    if(num_voices < 1) num_voices = 1;
+    if(num_voices > MAX_VOICES) num_voices = MAX_VOICES;
+    x->num_voices = num_voices;
+    
+    for(int i = num_voices; i < MAX_VOICES; i++)
+    {
+        voice_init(&x->voices[i], x->voices[i].midi_pitch, x->time_stretch_factor);
+    }
+}
+/**
+ * @brief handles a MIDI note
+ * @details a note-on retriggers the voice already playing @a midi_pitch or allocates a new one, stealing a voice if all are in use; a note-off releases the voice playing @a midi_pitch. Never allocates memory <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param midi_pitch MIDI pitch/key value <br>
+ * @param midi_velo MIDI velocity value, 0 for note-off <br>
+ */
+void c_granular_synth_note(c_granular_synth *x, int midi_pitch, int midi_velo)
+{
+    int num_voices = c_granular_synth_playable_voices(x);
+    int i = voice_find(x->voices, num_voices, midi_pitch);
+    voice *v;
+    
+    if(midi_velo <= 0)
+    {
+        if(i >= 0) x->voices[i].midi_velo = 0;
+        return;
+    }
+    
+    if(i < 0) i = voice_allocate(x->voices, num_voices);
+    v = &x->voices[i];
+    voice_set_pitch(v, midi_pitch, x->time_stretch_factor);
+    v->midi_velo = midi_velo;
+    v->note_serial = ++x->note_counter;
+    v->samples_to_next_onset = 0;
+    
+    if(i == 0) x->pitch_factor = v->pitch_factor;
+}
+/**
+ * @brief retunes the latest held note
+ * @details a pitch without a velocity glides the voice of the most recent note-on that is still held to @a midi_pitch, its envelope keeps running. Does nothing if no note is held <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param midi_pitch MIDI pitch/key value <br>
+ */
+void c_granular_synth_set_pitch(c_granular_synth *x, int midi_pitch)
+{
+    int num_voices = c_granular_synth_playable_voices(x),
+        latest = -1;
+    
+    for(int i = 0; i < num_voices; i++)
+    {
+        if(x->voices[i].midi_velo > 0 && (latest < 0 || x->voices[i].note_serial > x->voices[latest].note_serial)) latest = i;
+    }
+    if(latest < 0) return;
+    
+    voice_set_pitch(&x->voices[latest], midi_pitch, x->time_stretch_factor);
+    if(latest == 0) x->pitch_factor = x->voices[0].pitch_factor;
+}
+/**
+ * @brief selects the grain scheduler
+ * @details switching to the density based scheduler invalidates the grain table, switching back lays out a new one <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param scheduler grain scheduler <br>
+ */
+void c_granular_synth_set_scheduler(c_granular_synth *x, enum grain_scheduler scheduler)
+{
+    if(x->scheduler == scheduler) return;
+    
+    x->scheduler = scheduler;
+    grain_pool_clear(&x->active_grains);
+    grain_pool_clear(&x->fading_grains);
+    if(x->scheduler == SCHEDULE_DENSITY)
+    {
+        x->grains_table_valid = false;
+        x->next_scheduled_grain = NULL;
+        for(int i = 0; i < MAX_VOICES; i++)
+        {
+            x->voices[i].samples_to_next_onset = 0;
+        }
+    }
+    else
+    {
+        c_granular_synth_request_grain_table(x);
+    }
+}
+/**
+ * @brief takes over a grain size
+ * @details the grain table scheduler lays out a new table, the density based scheduler uses the size for the next grains <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param grain_size_ms size of a grain in milliseconds <br>
+ */
+static void c_granular_synth_apply_grain_size(c_granular_synth *x, int grain_size_ms)
+{
+    if(x->grain_size_ms == grain_size_ms) return;
+    
+    x->grain_size_ms = grain_size_ms;
+    x->grain_size_samples = get_samples_from_ms(grain_size_ms, x->sr);
+    if(x->scheduler == SCHEDULE_TABLE) c_granular_synth_request_grain_table(x);
+}
+/**
+ * @brief takes over a start position
+ * @details the grain table scheduler lays out a new table around the position <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param start_pos position within the soundfile in samples <br>
+ */
+static void c_granular_synth_apply_start_pos(c_granular_synth *x, t_int start_pos)
+{
+    if(x->current_start_pos == start_pos) return;
+    
+    x->current_start_pos = start_pos;
+    if(x->scheduler == SCHEDULE_TABLE) c_granular_synth_request_grain_table(x);
+}
+/**
+ * @brief takes over a time stretch factor
+ * @details retunes every voice, the grain table scheduler lays out a new table for the pitch factor of the first voice <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param time_stretch_factor resizes sample length within a grain <br>
+ */
+static void c_granular_synth_apply_time_stretch_factor(c_granular_synth *x, float time_stretch_factor)
+{
+    if(x->time_stretch_factor == time_stretch_factor) return;
+    
+    x->time_stretch_factor = time_stretch_factor;
+    for(int i = 0; i < MAX_VOICES; i++)
     {
-        x->gauss_q_factor = gauss_q_factor;
+        voice_set_pitch(&x->voices[i], x->voices[i].midi_pitch, time_stretch_factor);
     }
+    x->pitch_factor = x->voices[0].pitch_factor;
+    if(x->scheduler == SCHEDULE_TABLE) c_granular_synth_request_grain_table(x);
+}
+/**
+ * @brief sets the grain size
+ * @details glides to the new size if a ramp time is set for it <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param grain_size_ms size of a grain in milliseconds <br>
+ */
+void c_granular_synth_set_grain_size(c_granular_synth *x, int grain_size_ms)
+{
+    purple_ramp_set(&x->ramps[RAMP_GRAIN_SIZE], grain_size_ms, x->ramp_samples[RAMP_GRAIN_SIZE]);
+    if(x->ramps[RAMP_GRAIN_SIZE].remaining == 0) c_granular_synth_apply_grain_size(x, grain_size_ms);
+}
+/**
+ * @brief sets the start position
+ * @details glides to the new position if a ramp time is set for it <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param start_pos position within the soundfile in samples <br>
+ */
+void c_granular_synth_set_start_pos(c_granular_synth *x, t_int start_pos)
+{
+    purple_ramp_set(&x->ramps[RAMP_START_POS], start_pos, x->ramp_samples[RAMP_START_POS]);
+    if(x->ramps[RAMP_START_POS].remaining == 0) c_granular_synth_apply_start_pos(x, start_pos);
+}
+/**
+ * @brief sets the time stretch factor
+ * @details glides to the new factor if a ramp time is set for it <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param time_stretch_factor resizes sample length within a grain <br>
+ */
+void c_granular_synth_set_time_stretch_factor(c_granular_synth *x, float time_stretch_factor)
+{
+    purple_ramp_set(&x->ramps[RAMP_TIME_STRETCH], time_stretch_factor, x->ramp_samples[RAMP_TIME_STRETCH]);
+    if(x->ramps[RAMP_TIME_STRETCH].remaining == 0) c_granular_synth_apply_time_stretch_factor(x, time_stretch_factor);
+}
+/**
+ * @brief sets the ramp time of a parameter
+ * @details a glide that is running keeps its length, the next change of the parameter uses the new time <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param r the ramped parameter <br>
+ * @param ramp_ms length of a glide in milliseconds, 0 sets the parameter right away <br>
+ */
+void c_granular_synth_set_ramp_time(c_granular_synth *x, enum synth_ramp r, int ramp_ms)
+{
+    x->ramp_samples[r] = (ramp_ms > 0) ? get_samples_from_ms(ramp_ms, x->sr) : 0;
+}
+/**
+ * @brief value of a ramped parameter
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param r the ramped parameter <br>
+ * @param k samples after the current sample of the ramp <br>
+ * @return value of the parameter at sample @a k, the target once the glide has ended <br>
+ */
+static float c_granular_synth_ramp(c_granular_synth *x, enum synth_ramp r, int k)
+{
+    return purple_ramp_value_at(&x->ramps[r], k);
+}
+/**
+ * @brief takes over the values of the ramps
+ * @details the density based scheduler follows the ramps after every block it renders, the grain table scheduler at the end of every grain cycle, so a glide lays out at most one grain table per grain <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param k samples after the current sample of the ramps <br>
+ */
+static void c_granular_synth_follow_ramps(c_granular_synth *x, int k)
+{
+    c_granular_synth_apply_start_pos(x, (t_int)lroundf(c_granular_synth_ramp(x, RAMP_START_POS, k)));
+    c_granular_synth_apply_grain_size(x, (int)lroundf(c_granular_synth_ramp(x, RAMP_GRAIN_SIZE, k)));
+    c_granular_synth_apply_time_stretch_factor(x, c_granular_synth_ramp(x, RAMP_TIME_STRETCH, k));
+}
+/**
+ * @brief sets the ADSR times
+ * @details the envelope is only updated if a time changed, the voices keep their stage <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param attack attack time in ms <br>
+ * @param decay decay time in ms <br>
+ * @param sustain sustain level in the range of 0 - 1 <br>
+ * @param release release time in ms <br>
+ */
+void c_granular_synth_set_adsr(c_granular_synth *x, int attack, int decay, float sustain, int release)
+{
+    if(x->adsr_env->attack != attack || x->adsr_env->decay != decay || x->adsr_env->sustain != sustain || x->adsr_env->release != release)
+    {
+        envelope_update(x->adsr_env, attack, decay, sustain, release);
+    }
+}
+/**
+ * @brief sets the grain window
+ * @details the window table is only recomputed when the shape or @a gauss_q_factor changes, on the worker thread, and the grains keep the current window until the new one is published <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param window_shape shape of the grain window <br>
+ * @param gauss_q_factor envelope manipulation value, taper ratio of the tukey window <br>
+ */
+void c_granular_synth_set_window(c_granular_synth *x, enum window_shape window_shape, float gauss_q_factor)
+{
+    if(x->gauss_q_factor == gauss_q_factor && x->window_shape == window_shape) return;
+    
+    x->gauss_q_factor = gauss_q_factor;
+    x->window_shape = window_shape;
+    c_granular_synth_request_window(x);
+}
+/**
+ * @brief applies a control event
+ * @details only the state the event refers to is updated, the other parameters and the grain table stay as they are <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param e the event <br>
+ */
+void c_granular_synth_apply_event(c_granular_synth *x, const synth_event *e)
+{
+    envelope *env = x->adsr_env;
+    
+    switch(e->type)
+    {
+        case EVENT_NOTE:
+            c_granular_synth_note(x, (int)e->value, (int)e->velocity);
+            break;
+        case EVENT_PITCH:
+            c_granular_synth_set_pitch(x, (int)e->value);
+            break;
+        case EVENT_GRAIN_SIZE:
+            c_granular_synth_set_grain_size(x, (int)e->value);
+            break;
+        case EVENT_START_POS:
+            c_granular_synth_set_start_pos(x, (t_int)e->value);
+            break;
+        case EVENT_TIME_STRETCH:
+            c_granular_synth_set_time_stretch_factor(x, e->value);
+            break;
+        case EVENT_SPRAY:
+            x->spray_input = (int)e->value;
+            break;
+        case EVENT_ATTACK:
+            c_granular_synth_set_adsr(x, (int)e->value, env->decay, env->sustain, env->release);
+            break;
+        case EVENT_DECAY:
+            c_granular_synth_set_adsr(x, env->attack, (int)e->value, env->sustain, env->release);
+            break;
+        case EVENT_SUSTAIN:
+            c_granular_synth_set_adsr(x, env->attack, env->decay, e->value, env->release);
+            break;
+        case EVENT_RELEASE:
+            c_granular_synth_set_adsr(x, env->attack, env->decay, env->sustain, (int)e->value);
+            break;
+        case EVENT_GAUSS_Q:
+            c_granular_synth_set_window(x, x->window_shape, e->value);
+            break;
+        case EVENT_WINDOW:
+            c_granular_synth_set_window(x, (enum window_shape)e->value, x->gauss_q_factor);
+            break;
+        case EVENT_INTERPOLATION:
+            x->interpolation = (enum interpolation)e->value;
+            break;
+        case EVENT_SCHEDULER:
+            c_granular_synth_set_scheduler(x, (enum grain_scheduler)e->value);
+            break;
+        case EVENT_DENSITY:
+            if(x->grain_density != e->value) c_granular_synth_set_grain_density(x, e->value);
+            break;
+        case EVENT_VOICES:
+            if(x->num_voices != (int)e->value) c_granular_synth_set_num_voices(x, (int)e->value);
+            break;
+    }
+}
+/**
+ * @brief renders a block with control events
+ * @details renders the block in pieces between the offsets of the events and applies every event right at its sample, so a note or a parameter change within the block does not wait for the next one <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param in input pointer of @a c_granular_synth_process object <br>
+ * @param out output pointer of the block <br>
+ * @param vector_size size of the block <br>
+ * @param events events of the block, sorted by offset <br>
+ * @param num_events number of @a events <br>
+ */
+void c_granular_synth_process_events(c_granular_synth *x, float *in, float *out, int vector_size, const synth_event *events, int num_events)
+{
+    int position = 0;
+    
+    for(int i = 0; i < num_events; i++)
+    {
+        int offset = events[i].offset;
+        if(offset > vector_size) offset = vector_size;
+        if(offset > position)
+        {
+            c_granular_synth_process(x, in + position, out + position, offset - position);
+            position = offset;
+        }
+        c_granular_synth_apply_event(x, &events[i]);
+    }
+    if(position < vector_size) c_granular_synth_process(x, in + position, out + position, vector_size - position);
 }
 /**
  * @author Kretschmar, Nikita 
@@ -336,16 +1194,16 @@ void c_granular_synth_properties_update(c_granular_synth *x, t_int grain_size_ms
  */
 void c_granular_synth_reset_playback_position(c_granular_synth *x)
 {
-    x->sprayed_start_pos = x->current_start_pos + x->spray_true_offset;
-    while(x->sprayed_start_pos < 0)
+    x->cycle_start_pos = x->current_start_pos;
+    while(x->cycle_start_pos < 0)
     {
-        x->sprayed_start_pos += (x->soundfile_length - 1);
+        x->cycle_start_pos += (x->soundfile_length - 1);
     }
-    while(x->sprayed_start_pos >= x->soundfile_length)
+    while(x->cycle_start_pos >= x->soundfile_length)
     {
-        x->sprayed_start_pos -= x->soundfile_length;
+        x->cycle_start_pos -= x->soundfile_length;
     }
-    x->playback_position = x->sprayed_start_pos;
+    x->playback_position = x->cycle_start_pos;
     
 
     x->playback_cycle_end = x->playback_position + x->grain_size_samples;
@@ -355,6 +1213,40 @@ void c_granular_synth_reset_playback_position(c_granular_synth *x)
     }
 }
 
+/**
+ * @brief sets the soundfile the grains read
+ * @details the synth takes over the reference to @a b. Handing in the current buffer again changes nothing, any other buffer is crossfaded to by the playing grains within @a BUFFER_CROSSFADE_SAMPLES, the voices, the window and the grains stay as they are.
+ * A buffer that read a pd array in place is dropped right away without a crossfade, pd may already have freed its words. A new length only lays out a new grain table <br>
+ * @param x input pointer of @a c_granular_synth object <br>
+ * @param b buffer acquired from the sample buffer cache, may be NULL <br>
+ */
+void c_granular_synth_set_buffer(c_granular_synth *x, sample_buffer *b)
+{
+    if(!b) return;
+    if(b == x->buffer)
+    {
+        sample_buffer_release(b);
+        return;
+    }
+    
+    sample_buffer_release(x->previous_buffer);
+    x->previous_buffer = x->buffer;
+    x->buffer = b;
+    x->crossfade_remaining = BUFFER_CROSSFADE_SAMPLES;
+    if(x->previous_buffer->storage == STORAGE_VIEW && x->previous_buffer->words)
+    {
+        sample_buffer_release(x->previous_buffer);
+        x->previous_buffer = NULL;
+        x->crossfade_remaining = 0;
+    }
+    
+    if(x->soundfile_length != b->length)
+    {
+        x->soundfile_length = b->length;
+        c_granular_synth_reset_playback_position(x);
+        if(x->scheduler == SCHEDULE_TABLE) c_granular_synth_request_grain_table(x);
+    }
+}
 /**
  * @related pd_granular_synth_tilde
  * @brief frees @a granular_synth object
@@ -365,9 +1257,12 @@ void c_granular_synth_free(c_granular_synth *x)
 {
     if(x)
     {
-        free(x->soundfile_table);
+        purple_worker_stop(&x->worker);
+        sample_buffer_release(x->buffer);
+        sample_buffer_release(x->previous_buffer);
+        purple_arena_release(&x->arena);
         free(x->grains_table);
-        envelope_free(x->adsr_env);
+        free(x->shadow_grains_table);
         free(x);
     }
 }
@@ -19,6 +19,11 @@
 #include "math.h"
 #include "grain.h"
 #include "envelope.h"
+#include "voice.h"
+#include "purple_worker.h"
+#include "grain_kernels.h"
+#include "mipmap.h"
+#include "sample_buffer.h"
 #include "m_pd.h"
 
 #ifdef __cplusplus
@@ -26,6 +31,90 @@ extern "C" {
 #endif
 
 #define NUMELEMENTS(x)  (sizeof(x) / sizeof((x)[0]))
+#define GRAIN_BLOCK_SIZE 64                     ///< number of samples the density based scheduler renders at once <br>
+#define BUFFER_CROSSFADE_SAMPLES 2048           ///< length of the crossfade of the playing grains from the previous to a new sample buffer <br>
+#define MAX_ONSET_INTERVAL_SECONDS 60           ///< longest inter-onset interval a modulated grain density reaches <br>
+
+/**
+ * @brief grain schedulers of the synth
+ */
+enum grain_scheduler {
+    SCHEDULE_TABLE,                             ///< grains laid out over the soundfile, started by the playback position <br>
+    SCHEDULE_DENSITY                            ///< grains created on demand according to the grain density <br>
+};
+
+/**
+ * @brief control events of the synth
+ */
+enum synth_event_type {
+    EVENT_NOTE,                                 ///< MIDI note, @a value is the pitch/key and @a velocity the velocity <br>
+    EVENT_PITCH,                                ///< MIDI pitch/key without a velocity, retunes the latest held note <br>
+    EVENT_GRAIN_SIZE,                           ///< grain size in milliseconds <br>
+    EVENT_START_POS,                            ///< start position in samples <br>
+    EVENT_TIME_STRETCH,                         ///< time stretch factor <br>
+    EVENT_SPRAY,                                ///< spray range in samples <br>
+    EVENT_ATTACK,                               ///< attack time in milliseconds <br>
+    EVENT_DECAY,                                ///< decay time in milliseconds <br>
+    EVENT_SUSTAIN,                              ///< sustain level <br>
+    EVENT_RELEASE,                              ///< release time in milliseconds <br>
+    EVENT_GAUSS_Q,                              ///< gauss q factor of the grain window <br>
+    EVENT_WINDOW,                               ///< shape of the grain window <br>
+    EVENT_INTERPOLATION,                        ///< interpolation between the samples of the soundfile <br>
+    EVENT_SCHEDULER,                            ///< grain scheduler <br>
+    EVENT_DENSITY,                              ///< grains per second of the density based scheduler <br>
+    EVENT_VOICES                                ///< number of voices <br>
+};
+
+/**
+ * @brief parameters that follow a signal
+ * @details every signal is added to its parameter and sampled when the density based scheduler starts a grain <br>
+ */
+enum synth_modulation {
+    MODULATE_START_POS,                         ///< start position in samples <br>
+    MODULATE_TIME_STRETCH,                      ///< time stretch factor <br>
+    MODULATE_GRAIN_SIZE,                        ///< grain size in milliseconds <br>
+    MODULATE_SPRAY,                             ///< spray range in milliseconds <br>
+    MODULATE_DENSITY,                           ///< grains per second <br>
+    NUM_MODULATIONS                             ///< number of modulated parameters <br>
+};
+
+/**
+ * @brief parameters that glide to a new value
+ */
+enum synth_ramp {
+    RAMP_START_POS,                             ///< start position in samples <br>
+    RAMP_GRAIN_SIZE,                            ///< grain size in milliseconds <br>
+    RAMP_TIME_STRETCH,                          ///< time stretch factor <br>
+    NUM_RAMPS                                   ///< number of ramped parameters <br>
+};
+
+/**
+ * @struct synth_event
+ * @brief a note or parameter change at a sample of a dsp block
+ */
+typedef struct synth_event
+{
+    int         offset;                         ///< sample of the block the event takes effect at <br>
+    enum synth_event_type type;                 ///< what the event changes <br>
+    float       value,                          ///< new value of the parameter, pitch/key of a note <br>
+                velocity;                       ///< velocity of a note <br>
+} synth_event;
+
+/**
+ * @struct grain_table_request
+ * @brief parameters a grain table is built from
+ * @details written by the dsp routine before the worker thread is woken, read by the worker while it builds the table <br>
+ */
+typedef struct grain_table_request
+{
+    int         num_grains,                     ///< number of grains of the table <br>
+                current_grain_index,            ///< index of the grain at the start position <br>
+                grain_size_samples,             ///< size of a grain in samples <br>
+                soundfile_length;               ///< length of the soundfile the grains are laid out over <br>
+    t_int       start_pos;                      ///< start position of the grain at @a current_grain_index <br>
+    float       pitch_factor;                   ///< pitch factor the grains are read with <br>
+    bool        reverse_playback;               ///< grains are laid out backwards from the start position <br>
+} grain_table_request;
 
 /**
  * @struct c_granular_synth
@@ -38,43 +127,98 @@ typedef struct c_granular_synth
     t_word      *soundfile;                     ///< pointer towards the soundfile <br>
     int         soundfile_length,               ///< lenght of the soundfile in samples <br>          
                 current_grain_index,            ///< index of the current grain <br>
-                current_adsr_stage_index,       ///< index of the current ADSR stage <br>
-                current_gauss_stage_index,      ///< index of the current gauss stage <br>
                 grain_size_ms,                  ///< size of a grain in milliseconds, adjustable through slider <br>
                 grain_size_samples,             ///< size of a grain in samples <br>
                 num_grains,                     ///< number of grains <br>
-                midi_pitch,                     ///< pitch/key value given by MIDI input <br>
-                midi_velo,                      ///< velocity value given by MIDI input <br>
+                grains_table_capacity,          ///< number of grains @a grains_table holds <br>
+                shadow_grains_table_capacity,   ///< number of grains @a shadow_grains_table holds, grown by the worker thread when a table needs more <br>
+                num_voices,                     ///< number of voices used by the density based scheduler, the grain table plays a single voice <br>
                 spray_input;                    ///< randomizes the start position of each grain <br>
-    float       gauss_q_factor,                 ///< used to manipulate grain envelope slope <br>
-                pitch_factor;                   ///< scaled by pitch/key value given by MIDI input <br>
+    float       gauss_q_factor,                 ///< used to manipulate grain envelope slope, taper ratio of the tukey window <br>
+                pitch_factor,                   ///< scaled by pitch/key value given by MIDI input <br>
+                grain_density,                  ///< grains per second started by the density based scheduler <br>
+                onset_interval_samples;         ///< inter-onset interval of the density based scheduler in samples <br>
+    enum grain_scheduler scheduler;             ///< active grain scheduler <br>
+    enum window_shape window_shape;             ///< shape of the grain window <br>
+    enum interpolation interpolation;           ///< interpolation between the samples of the soundfile <br>
     t_int       playback_position,              ///< which sample of the grain goes to the output next <br>
                 current_start_pos,              ///< position in the soundfle, determined by slider position <br>
-                sprayed_start_pos,              ///< start position is affected by @a spray_true_offset <br>
-                playback_cycle_end,             ///< determines when to reset @a playback_pos to @a current_start_pos <br>
-                spray_true_offset;              ///< actual starting position offset (initally set to 0) calculated on the run <br>
+                cycle_start_pos,                ///< @a current_start_pos wrapped into the soundfile, where the grain cycle starts <br>
+                playback_cycle_end;             ///< determines when to reset @a playback_pos to @a current_start_pos <br>
     bool        reverse_playback;               ///< used fo switch playback to reverse, depends on @a time_stretch_factor value negativity <br>
-    float       *soundfile_table;               ///< array containing the original soundfile <br>
+    sample_buffer *buffer,                      ///< soundfile the grains read <br>
+                *previous_buffer;               ///< soundfile that was replaced by @a buffer, faded out during @a crossfade_remaining, released when the next buffer is set <br>
+    int         crossfade_remaining;            ///< samples left until the playing grains read @a buffer only <br>
     t_float     output_buffer,                  ///< used to sum up the current samples of all active grains <br>
                 time_stretch_factor,            ///< resizes sample length within a grain, adjustable through slider <br>
                 sr;                             ///< defined samplerate <br>
-    grain       *grains_table;                  ///< array containing the grains <br>
-    envelope    *adsr_env;                      ///< ADSR envelope <br>
+    purple_arena arena;                         ///< holds every buffer used by the dsp routine, allocated once in @a c_granular_synth_new <br>
+    grain       *grains_table,                  ///< array containing the grains <br>
+                *shadow_grains_table,           ///< second grain table, the worker thread builds the next table in here <br>
+                *next_scheduled_grain;          ///< grain of @a grains_table that is started next when the playback position reaches it <br>
+    grain * _Atomic ready_grains_table;         ///< set by the worker thread once @a shadow_grains_table is built, taken over by the dsp routine <br>
+    grain_table_request table_request;          ///< parameters of the grain table that is being built <br>
+    bool        grains_table_valid,             ///< false while @a grains_table has to be populated before playback <br>
+                grains_table_building,          ///< a grain table request is in progress and @a table_request must not be touched <br>
+                grains_table_outdated;          ///< parameters changed while a grain table was being built <br>
+    int         samples_since_table_request;    ///< samples played since the grain table being built was requested, the grains started within them are replayed by the new table <br>
+    purple_worker worker;                       ///< thread building the grain tables and the grain windows <br>
+    atomic_bool grains_table_job,               ///< set when the worker thread has to build @a table_request <br>
+                window_job;                     ///< set when the worker thread has to fill @a shadow_window <br>
+    grain_pool  active_grains;                  ///< grains that are currently playing <br>
+    grain_pool  fading_grains;                  ///< grains of the previous grain table, play to the end of their window while the new table starts <br>
+    envelope    *adsr_env;                      ///< ADSR times shared by all voices <br>
+    window      *grain_window,                  ///< precomputed grain window <br>
+                *shadow_window;                 ///< second grain window, the worker thread fills the next window in here <br>
+    window * _Atomic ready_window;              ///< set by the worker thread once @a shadow_window is filled, taken over by the dsp routine <br>
+    enum window_shape window_request_shape;     ///< shape of the grain window that is being filled <br>
+    float       window_request_q;               ///< q factor of the grain window that is being filled <br>
+    bool        window_building,                ///< a grain window request is in progress and the window request must not be touched <br>
+                window_outdated;                ///< shape or q factor changed while a grain window was being filled <br>
+    voice       voices[MAX_VOICES];             ///< voices with their own note, pitch factor and ADSR state <br>
+    float       voice_gains[MAX_VOICES][GRAIN_BLOCK_SIZE]; ///< ADSR values of every voice for the block rendered by the density based scheduler <br>
+    float       crossfade_gains[GRAIN_BLOCK_SIZE],  ///< gain of @a previous_buffer for every sample of the block rendered by the density based scheduler <br>
+                fade_gains[2][GRAIN_BLOCK_SIZE];    ///< ADSR values of one grain weighted for @a previous_buffer and @a buffer <br>
+    grain_span_kernel render_span;              ///< fastest grain kernel of the CPU <br>
+    const float *modulation[NUM_MODULATIONS];   ///< signals added to the parameters, point to the sample rendered next, NULL if a parameter is not modulated <br>
+    int         block_index;                    ///< sample of the current @a c_granular_synth_process call rendered next <br>
+    purple_ramp ramps[NUM_RAMPS];               ///< glides of start position, grain size and time stretch factor, new grains take their value at the onset <br>
+    int         ramp_samples[NUM_RAMPS];        ///< length of a glide in samples, 0 sets the parameter right away <br>
+    unsigned long note_counter;                 ///< number of note-ons so far, used to find the oldest voice <br>
 } c_granular_synth;
 
 void c_granular_synth_free(c_granular_synth *x);
-c_granular_synth *c_granular_synth_new(t_word *soundfile, int soundfile_length, int grain_size_ms, t_int start_pos, float time_stretch_factor, int attack, int decay, float sustain, int release, float gauss_q_factor, int spray_input, float pitch_factor, int midi_pitch);
+void c_granular_synth_set_buffer(c_granular_synth *x, sample_buffer *b);
+c_granular_synth *c_granular_synth_new(sample_buffer *buffer, int grain_size_ms, t_int start_pos, float time_stretch_factor, int attack, int decay, float sustain, int release, float gauss_q_factor, int spray_input, float pitch_factor, int midi_pitch, enum grain_scheduler scheduler, float grain_density, int num_voices, enum window_shape window_shape, enum interpolation interpolation);
 void c_granular_synth_generate_window_function(c_granular_synth *x);
 void c_granular_synth_process(c_granular_synth *x, float *in, float *out, int vector_size);
 void c_granular_synth_set_num_grains(c_granular_synth *x);
 void c_granular_synth_adjust_current_grain_index(c_granular_synth *x);
 void c_granular_synth_populate_grain_table(c_granular_synth *x);
-void grain_internal_scheduling(grain* g, c_granular_synth* synth);
+void c_granular_synth_request_grain_table(c_granular_synth *x);
+void c_granular_synth_publish_grain_table(c_granular_synth *x);
+bool c_granular_synth_schedule_grains(c_granular_synth *x);
+void c_granular_synth_render_density(c_granular_synth *x, float *out, int length);
+void c_granular_synth_set_grain_density(c_granular_synth *x, float grain_density);
+bool grain_is_in_playback_range(t_float start, t_float end, t_int grain_index, c_granular_synth *synth);
+float grain_process_sample(grain_pool *p, int i, c_granular_synth *synth);
 void c_granular_synth_reset_playback_position(c_granular_synth *x);
-void c_granular_synth_properties_update(c_granular_synth *x, t_int grain_size_ms, t_int start_pos, float time_stretch_factor, t_int midi_velo, t_int midi_pitch, t_int attack, t_int decay, float sustain, t_int release, float gauss_q_factor, t_int spray_input);
+void c_granular_synth_note(c_granular_synth *x, int midi_pitch, int midi_velo);
+void c_granular_synth_set_pitch(c_granular_synth *x, int midi_pitch);
+void c_granular_synth_set_scheduler(c_granular_synth *x, enum grain_scheduler scheduler);
+void c_granular_synth_set_grain_size(c_granular_synth *x, int grain_size_ms);
+void c_granular_synth_set_start_pos(c_granular_synth *x, t_int start_pos);
+void c_granular_synth_set_time_stretch_factor(c_granular_synth *x, float time_stretch_factor);
+void c_granular_synth_set_adsr(c_granular_synth *x, int attack, int decay, float sustain, int release);
+void c_granular_synth_set_window(c_granular_synth *x, enum window_shape window_shape, float gauss_q_factor);
+void c_granular_synth_set_ramp_time(c_granular_synth *x, enum synth_ramp r, int ramp_ms);
+void c_granular_synth_set_modulation(c_granular_synth *x, enum synth_modulation m, const float *signal);
+void c_granular_synth_apply_event(c_granular_synth *x, const synth_event *e);
+void c_granular_synth_process_events(c_granular_synth *x, float *in, float *out, int vector_size, const synth_event *events, int num_events);
+void c_granular_synth_set_num_voices(c_granular_synth *x, int num_voices);
+int c_granular_synth_playable_voices(c_granular_synth *x);
 extern t_float SAMPLERATE;
-float calculate_adsr_value(c_granular_synth *x);
-float gauss (c_granular_synth *x);
+float calculate_adsr_value(envelope *env, voice *v);
 
 #ifdef __cplusplus
 }
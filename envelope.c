@@ -6,7 +6,7 @@
  * @author Wennemann,Tim <br>
  * Audiocommunication Group, Technische Universität Berlin <br>
  * @brief handles envelope generation
- * @details generates ADSR envelope according to adjustable attack, decay, sustain and release parameters <br>
+ * @details generates ADSR envelope according to adjustable attack, decay, sustain and release parameters and the precomputed grain windows <br>
  * @version 1.1
  * @date 2021-09-27
  * 
@@ -26,62 +26,63 @@
  * @author Strobl, Micha 
  * @author Wennemann,Tim <br>
  * @brief calculates ADSR value
- * @details calculates single momentary ADSR value according to current state <br>
- * @param x input pointer of @a c_granular_synth object <br>
+ * @details calculates single momentary ADSR value of a voice according to its current state <br>
+ * @param env ADSR times shared by all voices <br>
+ * @param v voice whose ADSR state is advanced <br>
  * @return ADSR value of type float <br>
  */
-float calculate_adsr_value(c_granular_synth *x)
+float calculate_adsr_value(envelope *env, voice *v)
 {
     float adsr_val = 0;
     float attack_val = 0;
-    switch(x->adsr_env->adsr)
+    switch(v->adsr)
     {
         case ATTACK:
-            attack_val = (1.0/x->adsr_env->attack_samples);
-            adsr_val = x->current_adsr_stage_index++ * attack_val;
-            x->adsr_env->peak = adsr_val;
-            if(x->current_adsr_stage_index >= x->adsr_env->attack_samples)
+            attack_val = (1.0/env->attack_samples);
+            adsr_val = v->current_adsr_stage_index++ * attack_val;
+            v->peak = adsr_val;
+            if(v->current_adsr_stage_index >= env->attack_samples)
             {
-                x->current_adsr_stage_index = 0;
-                x->adsr_env->adsr = DECAY;
+                v->current_adsr_stage_index = 0;
+                v->adsr = DECAY;
             }
             break;
         case DECAY:
-            adsr_val = 1.0 + ((x->adsr_env->sustain-1.0)/x->adsr_env->decay_samples*x->current_adsr_stage_index++);
-            x->adsr_env->peak = adsr_val;
-            if(x->current_adsr_stage_index >= x->adsr_env->decay_samples)
+            adsr_val = 1.0 + ((env->sustain-1.0)/env->decay_samples*v->current_adsr_stage_index++);
+            v->peak = adsr_val;
+            if(v->current_adsr_stage_index >= env->decay_samples)
             {
-                x->current_adsr_stage_index = 0;
-                x->adsr_env->adsr = SUSTAIN;
+                v->current_adsr_stage_index = 0;
+                v->adsr = SUSTAIN;
             }
             break;
         case SUSTAIN:
-            adsr_val = x->adsr_env->sustain;
-            if(x->adsr_env->peak != x->adsr_env->sustain) x->adsr_env->peak = x->adsr_env->sustain;
+            adsr_val = env->sustain;
+            if(v->peak != env->sustain) v->peak = env->sustain;
             break;
         case RELEASE:
-            if(x->midi_velo > 0)
+            if(v->midi_velo > 0)
             {
-                x->adsr_env->adsr = ATTACK;
-                x->current_adsr_stage_index = 0;
+                v->adsr = ATTACK;
+                v->current_adsr_stage_index = 0;
                 break;
             }
-            adsr_val = x->adsr_env->peak - ((x->adsr_env->peak/x->adsr_env->release_samples)*x->current_adsr_stage_index++);
-            if(x->current_adsr_stage_index >= x->adsr_env->release_samples)
+            adsr_val = v->peak - ((v->peak/env->release_samples)*v->current_adsr_stage_index++);
+            if(v->current_adsr_stage_index >= env->release_samples)
             {
-                x->current_adsr_stage_index = 0;
-                x->adsr_env->adsr = SILENT;
+                v->current_adsr_stage_index = 0;
+                v->adsr = SILENT;
             }
             break;
         case SILENT:
-            if(x->midi_velo>0)
+            if(v->midi_velo>0)
             {
-                x->adsr_env->adsr = ATTACK;
-                x->current_adsr_stage_index = 0;
+                v->adsr = ATTACK;
+                v->current_adsr_stage_index = 0;
                 break;
             }
             adsr_val = 0;
-            x->adsr_env->peak = 0;
+            v->peak = 0;
             break;
     }
     return adsr_val;
@@ -90,57 +91,135 @@ float calculate_adsr_value(c_granular_synth *x)
 /**
  * @brief generates new ADSR envelope
  * @details generates new ADSR envelope according to its four components <br>
+ * @param arena arena of the synth the envelope is allocated from <br>
  * @param attack attack time in the range of 0 - 4000ms, adjustable through slider <br>
  * @param decay decay time in the range of 0 - 4000ms, adjustable through slider <br>
  * @param sustain sustain time in the range of 0 - 1, adjustable through slider <br>
  * @param release release time in the range of 0 - 10000ms, adjustable through slider <br>
  * @return envelope* 
  */
-envelope *envelope_new(int attack, int decay, float sustain, int release)
+envelope *envelope_new(purple_arena *arena, int attack, int decay, float sustain, int release)
 
 {
-    envelope *x = (envelope *) malloc(sizeof(envelope));
+    envelope *x = (envelope *) purple_arena_alloc(arena, sizeof(envelope));
+    envelope_update(x, attack, decay, sustain, release);
+    return x;
+}
+
+/**
+ * @brief updates an ADSR envelope
+ * @details sets the four components in place and recalculates their length in samples <br>
+ * @param x input pointer of @a envelope object <br>
+ * @param attack attack time in the range of 0 - 4000ms, adjustable through slider <br>
+ * @param decay decay time in the range of 0 - 4000ms, adjustable through slider <br>
+ * @param sustain sustain time in the range of 0 - 1, adjustable through slider <br>
+ * @param release release time in the range of 0 - 10000ms, adjustable through slider <br>
+ */
+void envelope_update(envelope *x, int attack, int decay, float sustain, int release)
+{
     t_float SAMPLERATE = sys_getsr();
     
-    x->adsr = SILENT;
     x->attack = attack;
     x->decay = decay;
     x->sustain = sustain;
-    x->peak = 0.0;
     x->release = release;
     
     x->attack_samples = get_samples_from_ms(attack, SAMPLERATE);
     x->decay_samples = get_samples_from_ms(decay, SAMPLERATE);
     x->release_samples = get_samples_from_ms(release, SAMPLERATE);
-    return x;
 }
 
 /**
- * @brief calculates gauss value
- * @details calculates gauss value according to @a grain index <br>
- * @param x reference to the actual synthesizer <b>
- * @return gauss value of type float <b>
+ * @brief evaluates a window shape
+ * @details only used to fill the window tables, never on the audio path <br>
+ * @param shape shape of the window <br>
+ * @param q_factor q factor of the gauss distribution or taper ratio of the tukey window <br>
+ * @param phase position within the window in the range of 0 - 1 <br>
+ * @return window value of type float <br>
+ */
+static float window_shape_value(enum window_shape shape, float q_factor, float phase)
+{
+    switch(shape)
+    {
+        case WINDOW_HANN:
+            return 0.5 - 0.5 * cos(2 * M_PI * phase);
+        case WINDOW_TUKEY:
+            if(phase < q_factor / 2) return 0.5 - 0.5 * cos(2 * M_PI * phase / q_factor);
+            if(phase > 1 - q_factor / 2) return 0.5 - 0.5 * cos(2 * M_PI * (1 - phase) / q_factor);
+            return 1;
+        case WINDOW_BLACKMAN:
+            return 0.42 - 0.5 * cos(2 * M_PI * phase) + 0.08 * cos(4 * M_PI * phase);
+        case WINDOW_GAUSS:
+        default:
+            return exp(-pow(phase - 0.5, 2) / q_factor);
+    }
+}
+
+/**
+ * @brief generates a new window table
+ * @param arena arena of the synth the window is allocated from <br>
+ * @param shape shape of the window <br>
+ * @param q_factor q factor of the gauss distribution or taper ratio of the tukey window <br>
+ * @param resolution number of table points per window period <br>
+ * @return window* 
+ */
+window *window_new(purple_arena *arena, enum window_shape shape, float q_factor, int resolution)
+{
+    window *w = (window *) purple_arena_alloc(arena, sizeof(window));
+    w->resolution = resolution;
+    w->window_samples_table = (t_sample *) purple_arena_alloc(arena, (resolution + 1) * sizeof(t_sample));
+    w->q_factor = -1;
+    w->shape = shape;
+    window_update(w, shape, q_factor);
+    return w;
+}
+
+/**
+ * @brief recomputes a window table
+ * @details refills the table in place, nothing happens if @a shape and @a q_factor match the current table. Hann and blackman windows ignore the q factor <br>
+ * @param w pointer to the window <br>
+ * @param shape shape of the window <br>
+ * @param q_factor q factor of the gauss distribution or taper ratio of the tukey window, limited to 0.001 - 1 <br>
  */
-float gauss(c_granular_synth *x)
+void window_update(window *w, enum window_shape shape, float q_factor)
 {
-    if (x->grain_size_samples == 0)
-        return 0;
-    if (x->current_gauss_stage_index >= x->grain_size_samples)
+    if(q_factor < 0.001) q_factor = 0.001;
+    if(q_factor > 1 && shape == WINDOW_TUKEY) q_factor = 1;
+    if(shape == WINDOW_HANN || shape == WINDOW_BLACKMAN) q_factor = 0;
+    if(w->shape == shape && w->q_factor == q_factor) return;
+    
+    w->shape = shape;
+    w->q_factor = q_factor;
+    for(int i = 0; i <= w->resolution; i++)
     {
-        x->current_gauss_stage_index = 0;
+        w->window_samples_table[i] = window_shape_value(shape, q_factor, (float)i / w->resolution);
     }
-    float numerator = pow(x->current_gauss_stage_index++ -(x->grain_size_samples/2), 2);
-    float denominatior = x->gauss_q_factor * pow(x->grain_size_samples, 2);
-    float gauss_value = expf(-numerator/denominatior);
-    return gauss_value;
 }
 
 /**
- * @brief frees envelope
- * @details frees envelope <br>
- * @param x input pointer of @a envelope object
+ * @brief reads a window table
+ * @details linear interpolation between the two table points around @a phase <br>
+ * @param w pointer to the window <br>
+ * @param phase position within the window in the range of 0 - 1 <br>
+ * @return window value of type float <br>
+ */
+float window_lookup(window *w, float phase)
+{
+    if(phase <= 0) return w->window_samples_table[0];
+    if(phase >= 1) return w->window_samples_table[w->resolution];
+    
+    float position = phase * w->resolution;
+    int index = (int)position;
+    float frac = position - index;
+    return get_interpolated_sample_value(w->window_samples_table[index], w->window_samples_table[index + 1], frac);
+}
+
+/**
+ * @brief arena memory needed by a window
+ * @param resolution number of table points per window period <br>
+ * @return size_t size in bytes <br>
  */
-void envelope_free(envelope *x)
+size_t window_arena_size(int resolution)
 {
-    free(x);
+    return purple_arena_aligned_size(sizeof(window)) + purple_arena_aligned_size((resolution + 1) * sizeof(t_sample));
 }
@@ -15,6 +15,7 @@
 
 #include "m_pd.h"
 #include "grain.h"
+#include "purple_utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -32,10 +33,22 @@ enum adsr_stage {
     SILENT
 };
 
+/**
+ * @brief window shapes of the grains
+ */
+enum window_shape {
+    WINDOW_GAUSS,
+    WINDOW_HANN,
+    WINDOW_TUKEY,
+    WINDOW_BLACKMAN
+};
+
+#define WINDOW_TABLE_SIZE 4096                  ///< resolution of the precomputed window tables <br>
+
 /**
  * @struct envelope
  * @brief pure data struct of the @a envelope object
- * @details pure data struct of the @a envelope object, defines all necessary variables for enevelope generation <br>
+ * @details pure data struct of the @a envelope object, defines all necessary variables for enevelope generation, the ADSR state itself is kept per voice <br>
  */
 
 typedef struct envelope
@@ -43,36 +56,34 @@ typedef struct envelope
     t_object x_obj;                     ///< object used for method input/output handling <br>
     int     attack;                    ///< attack time in the range of 0 - 4000ms, adjustable through slider <br>
     int     decay;                     ///< decay time in the range of 0 - 4000ms, adjustable through slider <br>
-    float   peak,                      ///< maximum value reached within one adsr cycle <br>
-            sustain;                   ///< sustain time in the range of 0 - 1, adjustable through slider <br>
+    float   sustain;                   ///< sustain time in the range of 0 - 1, adjustable through slider <br>
     int     release;                   ///< release time in the range of 0 - 10000ms, adjustable through slider <br>
     int     attack_samples,            ///< attack time in samples <br>
             decay_samples,             ///< decay time in samples <br>
             release_samples;           ///< release time in samples <br>
-    enum adsr_stage adsr;               ///< current ADSR stage <br>
 } envelope;
 
 int getsamples_from_ms(int ms, float sr);
 /**
  * @struct window
- * @brief pure data struct of the @a window object
- * @details pure data struct of the @a window object, defines all necessary variables for windowing <br>
+ * @brief precomputed grain window
+ * @details one period of the window shape sampled at @a resolution points plus a guard point, read by phase with linear interpolation. The table is keyed by @a shape, @a q_factor and @a resolution and only recomputed when one of them changes <br>
  */
 typedef struct window
 {
-    t_object x_obj;                     ///< object used for method input/output handling <br>
-    t_int q_factor;                     ///< q factor of the gauss distribution <br>
-    t_sample *window_samples_table;     ///< array containing the window samples <br>
+    enum window_shape shape;            ///< shape of the window <br>
+    float q_factor;                     ///< q factor of the gauss distribution, taper ratio of the tukey window, unused by hann and blackman <br>
+    int resolution;                     ///< number of table points per window period <br>
+    t_sample *window_samples_table;     ///< array containing the window samples, @a resolution + 1 entries <br>
 }window;
 
-envelope *envelope_new(int attack, int decay, float sustain, int release);
+window *window_new(purple_arena *arena, enum window_shape shape, float q_factor, int resolution);
+void window_update(window *w, enum window_shape shape, float q_factor);
+float window_lookup(window *w, float phase);
+size_t window_arena_size(int resolution);
 
-/**
- * @brief frees envelope
- * @details frees envelope, necessary reset for further instances of envelope generation <br>
- * @param x input pointer of @a envelope_free object
- */
-void envelope_free(envelope *x);
+envelope *envelope_new(purple_arena *arena, int attack, int decay, float sustain, int release);
+void envelope_update(envelope *x, int attack, int decay, float sustain, int release);
 
 #ifdef __cplusplus
 }
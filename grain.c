@@ -6,8 +6,8 @@
  * @author Wennemann,Tim <br>
  * Audiocommunication Group, Technische Universität Berlin <br>
  * @brief handles grain creation
- * @details handles grain creation and basic scheduling according to input parameters set by the synthesizer<br>
- * @version 1.1
+ * @details handles grain creation, the pool of playing grains and basic scheduling according to input parameters set by the synthesizer<br>
+ * @version 1.2
  * @date 2021-09-27
  * 
  * @copyright Copyright (c) 2021
@@ -17,6 +17,7 @@
 #include "c_granular_synth.h"
 #include "envelope.h"
 #include "purple_utils.h"
+#include "grain_kernels.h"
 
 /**
  * @brief generates new grain
@@ -31,12 +32,9 @@
 grain grain_new(int grain_size_samples, int soundfile_size, float start_pos, int grain_index, float time_stretch_factor)
 {
     grain x;
-    x.grain_active = false;
     x.grain_size_samples = grain_size_samples;
     x.grain_index = grain_index;
-    x.internal_step_count = 0;
     x.time_stretch_factor = time_stretch_factor;
-    bool reverse_playback = x.time_stretch_factor < 0.0;
     
     x.start = start_pos;
     if(x.start < 0) x.start += (soundfile_size - 1);
@@ -45,94 +43,239 @@ grain grain_new(int grain_size_samples, int soundfile_size, float start_pos, int
     if(x.end < 0) x.end += soundfile_size - 1;
     if(x.end > soundfile_size - 1) x.end -= (soundfile_size - 1);
 
-    x.current_sample_pos = x.start;
-    x.next_sample_pos = x.current_sample_pos + x.time_stretch_factor;
-    
-    if(reverse_playback)
-    {
-        if(x.next_sample_pos < 0) x.next_sample_pos += (soundfile_size - 1);
-        if(x.next_sample_pos < x.end && x.start > x.end) x.next_sample_pos = x.end;
- 
-    }
-    else
-    {
-        if(x.next_sample_pos > (soundfile_size - 1)) x.next_sample_pos -= (soundfile_size - 1);
-        if(x.next_sample_pos >= x.end && x.start < x.end) x.next_sample_pos = x.end;
-    }
+    x.position = fixed_wrap(fixed_from_float(x.start), (fixed_position)(soundfile_size - 1) << FIXED_FRACTION_BITS);
+    x.increment = fixed_from_float(x.time_stretch_factor);
+    x.window_increment = (x.grain_size_samples > 0) ? 1.0 / x.grain_size_samples : 0;
+    x.amplitude = 1.0;
 
     return x;
 }
 /**
  * @author Strobl, Micha <br>
- * @brief scheduling of grain playback
- * @details recursive scheduling of successive grain playback with time and/or start position shifts <br>
- * @param g grain <br>
+ * @brief checks whether a grain is reached by the playback position
+ * @details the current grain is always active, every other grain only while the playback position lies between its start and end <br>
+ * @param start starting point of the grain <br>
+ * @param end ending point of the grain <br>
+ * @param grain_index index of the grain in the grain table <br>
  * @param synth pointer to c_granular_synth object that schedules the grain <br>
+ * @return true if the grain has to be played <br>
  */
-void grain_internal_scheduling(grain* g, c_granular_synth* synth)
+bool grain_is_in_playback_range(t_float start, t_float end, t_int grain_index, c_granular_synth *synth)
 {
+    if(grain_index == synth->current_grain_index) return true;
+    
     if(synth->reverse_playback)
     {
-        g->grain_active = g->grain_index == synth->current_grain_index ||
-        ((((synth->soundfile_length - 1 - synth->playback_position) <= g->start) &&
-          ((synth->soundfile_length - 1 - synth->playback_position) >= g->end)));
+        return (((synth->soundfile_length - 1 - synth->playback_position) <= start) &&
+                ((synth->soundfile_length - 1 - synth->playback_position) >= end));
     }
-    else
+    return ((start <= synth->playback_position) &&
+            (end >= synth->playback_position));
+}
+/**
+ * @author Strobl, Micha <br>
+ * @brief plays one sample of a grain
+ * @details reads the interpolated sample at the current grain position from the level of the soundfile pyramid that matches the grain's speed, mixed with the previous soundfile while the synth crossfades to a new one, weights it by the window value, the amplitude of the grain and the ADSR value of its voice and advances the grain by its fixed point increment and its window by its window increment <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param synth pointer to c_granular_synth object that schedules the grain <br>
+ * @return weighted sample value <br>
+ */
+float grain_process_sample(grain_pool *p, int i, c_granular_synth *synth)
+{
+    fixed_position  wrap = (fixed_position)(synth->soundfile_length - 1) << FIXED_FRACTION_BITS;
+    float           rate = fabsf(p->time_stretch_factor[i]),
+                    gain,
+                    sample;
+    
+    gain = window_lookup(synth->grain_window, p->window_phase[i]) * p->amplitude[i] * synth->voices[p->voice_index[i]].gain;
+    sample = sample_buffer_read(synth->buffer, p->position[i], rate, synth->interpolation);
+    if(synth->crossfade_remaining > 0)
     {
-        g->grain_active = g->grain_index == synth->current_grain_index ||
-        ((g->start <= synth->playback_position) &&
-         (g->end >= synth->playback_position));
+        sample += (sample_buffer_read(synth->previous_buffer, p->position[i], rate, synth->interpolation) - sample) * synth->crossfade_remaining / BUFFER_CROSSFADE_SAMPLES;
     }
+    p->window_phase[i] += p->window_increment[i];
+    p->position[i] += p->increment[i];
+    if(p->position[i] >= wrap || p->position[i] < 0) p->position[i] = fixed_wrap(p->position[i], wrap);
+    p->remaining[i]--;
+    p->played[i]++;
+    return sample * gain;
+}
+/**
+ * @brief empties the grain pool
+ * @param p pointer to the @a grain_pool <br>
+ */
+void grain_pool_clear(grain_pool *p)
+{
+    p->num_active = 0;
+}
+/**
+ * @brief starts a grain
+ * @details copies @a g into the slot behind the last playing grain <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param g grain to start <br>
+ * @param voice_index voice that starts the grain <br>
+ * @param block_offset first sample of the current block the grain plays in <br>
+ * @return int slot of the started grain, -1 if the pool is full <br>
+ */
+int grain_pool_start(grain_pool *p, const grain *g, int voice_index, int block_offset)
+{
+    if(p->num_active >= GRAIN_POOL_CAPACITY) return -1;
+    
+    int i = p->num_active++;
+    p->position[i] = g->position;
+    p->increment[i] = g->increment;
+    p->window_phase[i] = 0;
+    p->window_increment[i] = g->window_increment;
+    p->amplitude[i] = g->amplitude;
+    p->time_stretch_factor[i] = g->time_stretch_factor;
+    p->speed_offset[i] = 0;
+    p->remaining[i] = g->grain_size_samples;
+    p->played[i] = 0;
+    p->voice_index[i] = voice_index;
+    p->block_offset[i] = block_offset;
+    p->start[i] = g->start;
+    p->end[i] = g->end;
+    p->grain_index[i] = g->grain_index;
+    p->grain_size_samples[i] = g->grain_size_samples;
+    return i;
+}
+/**
+ * @brief restarts a grain
+ * @details moves the grain back to its start position and undoes @a grain_pool_fade <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ */
+void grain_pool_restart(grain_pool *p, int i, int soundfile_size)
+{
+    p->position[i] = fixed_wrap(fixed_from_float(p->start[i]), (fixed_position)(soundfile_size - 1) << FIXED_FRACTION_BITS);
+    p->remaining[i] = p->grain_size_samples[i];
+    p->played[i] = 0;
+    p->window_phase[i] = 0;
+    p->window_increment[i] = (p->grain_size_samples[i] > 0) ? 1.0 / p->grain_size_samples[i] : 0;
+}
+/**
+ * @brief moves the read position of a grain
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param offset shift in samples <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ */
+void grain_pool_offset(grain_pool *p, int i, int offset, int soundfile_size)
+{
+    p->position[i] = fixed_wrap(p->position[i] + (fixed_position)offset * FIXED_ONE, (fixed_position)(soundfile_size - 1) << FIXED_FRACTION_BITS);
+}
+/**
+ * @brief changes the speed of a grain
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param time_stretch_factor step size used from now on <br>
+ */
+void grain_pool_set_speed(grain_pool *p, int i, float time_stretch_factor)
+{
+    if(p->time_stretch_factor[i] == time_stretch_factor) return;
+    p->time_stretch_factor[i] = time_stretch_factor;
+    p->increment[i] = fixed_from_float(time_stretch_factor);
+}
+/**
+ * @brief advances a grain by several samples
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param num_samples number of samples the grain played <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ */
+void grain_pool_advance(grain_pool *p, int i, int num_samples, int soundfile_size)
+{
+    p->position[i] = fixed_wrap(p->position[i] + num_samples * p->increment[i], (fixed_position)(soundfile_size - 1) << FIXED_FRACTION_BITS);
+    p->window_phase[i] += num_samples * p->window_increment[i];
+    p->remaining[i] -= num_samples;
+    p->played[i] += num_samples;
+}
+/**
+ * @brief fades a grain out early
+ * @details every window is symmetric, a grain still in the rising half continues from the same window value in the falling half.
+ * Grains that can play all of their remaining samples are left as they are <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param num_samples number of samples the grain can still play <br>
+ */
+void grain_pool_fade(grain_pool *p, int i, int num_samples)
+{
+    if(num_samples >= p->remaining[i]) return;
     
-    if(g->grain_active)
+    if(p->window_phase[i] < 0.5f) p->window_phase[i] = 1 - p->window_phase[i];
+    if(num_samples > 0) p->window_increment[i] = (1 - p->window_phase[i]) / num_samples;
+    p->remaining[i] = num_samples;
+}
+/**
+ * @brief copies the grain of one slot into another
+ * @param p pointer to the destination @a grain_pool <br>
+ * @param to destination slot <br>
+ * @param q pointer to the source @a grain_pool, may be @a p <br>
+ * @param from source slot <br>
+ */
+static void grain_pool_move(grain_pool *p, int to, const grain_pool *q, int from)
+{
+    p->position[to] = q->position[from];
+    p->increment[to] = q->increment[from];
+    p->window_phase[to] = q->window_phase[from];
+    p->window_increment[to] = q->window_increment[from];
+    p->amplitude[to] = q->amplitude[from];
+    p->time_stretch_factor[to] = q->time_stretch_factor[from];
+    p->speed_offset[to] = q->speed_offset[from];
+    p->remaining[to] = q->remaining[from];
+    p->played[to] = q->played[from];
+    p->voice_index[to] = q->voice_index[from];
+    p->block_offset[to] = q->block_offset[from];
+    p->start[to] = q->start[from];
+    p->end[to] = q->end[from];
+    p->grain_index[to] = q->grain_index[from];
+    p->grain_size_samples[to] = q->grain_size_samples[from];
+}
+/**
+ * @brief retires a grain
+ * @details moves the last playing grain into the slot of the retired one <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain to retire <br>
+ */
+void grain_pool_retire(grain_pool *p, int i)
+{
+    if(i < 0 || i >= p->num_active) return;
+    
+    p->num_active--;
+    if(i != p->num_active) grain_pool_move(p, i, p, p->num_active);
+}
+/**
+ * @brief retires a grain and all grains started after it
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the first grain to retire <br>
+ */
+void grain_pool_truncate(grain_pool *p, int i)
+{
+    if(i >= 0 && i < p->num_active) p->num_active = i;
+}
+/**
+ * @brief takes over the grains of another pool
+ * @details grains that started within the last @a started_within samples are dropped instead <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param from pool whose grains are moved, empty afterwards <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ * @param started_within number of most recent samples whose grains are not taken over <br>
+ */
+void grain_pool_take_over(grain_pool *p, grain_pool *from, int soundfile_size, int started_within)
+{
+    fixed_position wrap = (fixed_position)(soundfile_size - 1) << FIXED_FRACTION_BITS;
+    
+    for(int j = 0; j < from->num_active && p->num_active < GRAIN_POOL_CAPACITY; j++)
     {
-        float   left_sample, 
-                right_sample, 
-                frac, 
-                integral, 
-                weighted;
-        
-        left_sample = synth->soundfile_table[(int)floorf(g->current_sample_pos)];
-        right_sample = synth->soundfile_table[(int)ceilf(g->current_sample_pos)];
-        frac = modff(g->current_sample_pos, &integral);
-        weighted = get_interpolated_sample_value(left_sample, right_sample,frac);
-        synth->output_buffer += weighted;
-        g->current_sample_pos = g->next_sample_pos;
-        g->next_sample_pos += synth->pitch_factor;
-
-        if(g->next_sample_pos > (synth->soundfile_length - 1))
-        {
-            g->next_sample_pos -= (synth->soundfile_length - 1);
-        }
-        
-        if(g->next_sample_pos < 0.0)
-        {
-            g->next_sample_pos += (synth->soundfile_length - 1);
-        }
-        g->internal_step_count++;
-        
-        if(g->internal_step_count >= g->grain_size_samples)
-        {
-            g->current_sample_pos = g->start;
-            g->next_sample_pos = g->current_sample_pos + synth->pitch_factor;
-            g->internal_step_count = 0;
-            synth->spray_true_offset = 0;
-            c_granular_synth_reset_playback_position(synth);
-        }
-        
-        if(g->next_grain)
-        {
-            grain_internal_scheduling(g->next_grain, synth);
-        }
-        
-    }
-    else {
-        g->current_sample_pos = g->start;
-        g->next_sample_pos = g->current_sample_pos + synth->pitch_factor;
-        g->internal_step_count = 0;
-        return;
-        
+        int i;
+        if(from->played[j] <= started_within) continue;
+        i = p->num_active++;
+        grain_pool_move(p, i, from, j);
+        p->position[i] = fixed_wrap(p->position[i], wrap);
     }
+    from->num_active = 0;
 }
 /**
  * @brief frees grain
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdbool.h>
+#include "purple_utils.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,24 +28,54 @@ extern "C" {
 /**
  * @struct grain
  * @brief pure data struct of the @a grain object
- * @details pure data struct of the @a grain object, defines all necessary variables for grain management<br>
+ * @details pure data struct of the @a grain object, defines all necessary variables for grain management.
+ * Describes a grain of the grain table or a grain about to be started, the state of playing grains is kept in the @a grain_pool <br>
  */
 typedef struct grain
 {
     struct grain        *next_grain,            ///< next grain according to the current one, passed back and forth between instances of @a granular_synth and every instantiated grain <br>
                         *previous_grain;        ///< previous grain according to the current one, passed back and forth between instances of @a granular_synth and every instantiated grain <br>
     t_int               grain_size_samples,     ///< size of the grain in samples <br>
-                        grain_index,            ///< index of the current grain <br>
-                        internal_step_count;    ///< count of steps <br>
+                        grain_index;            ///< index of the current grain <br>
     t_float             start,                  ///< starting point <br>
                         end,                    ///< ending point <br>
                         time_stretch_factor,    ///< resizes sample length within a grain, for negative values read samples in backwards direction, adjustable through slider <br>
-                        current_sample_pos,     ///< position of the current sample <br>
-                        next_sample_pos;        ///< position of the next sample according to the current one <br>
-    bool                grain_active;           ///< current state of the grain, inactive or active <br>
-        
+                        window_increment,       ///< advance of the window phase per sample <br>
+                        amplitude;              ///< amplitude of the grain <br>
+    fixed_position      position,               ///< read position of the first sample in the range of 0 - (soundfile length - 1) <br>
+                        increment;              ///< @a time_stretch_factor as fixed point, advance of @a position per sample <br>
 } grain;
 
+#define GRAIN_POOL_CAPACITY 512                 ///< maximum number of simultaneously playing grains <br>
+#define GRAIN_TABLE_CAPACITY 16384              ///< maximum number of grains in the grain table, the tables only grow to it when a layout needs that many <br>
+
+/**
+ * @struct grain_pool
+ * @brief fixed-capacity pool of the currently playing grains
+ * @details the state of the playing grains is stored as one array per field, slot i of every array belongs to the same grain.
+ * The fields read and written for every sample come first, the fields only needed when a grain starts, restarts or is checked against the playback position are kept apart, so the per-sample loops walk contiguous memory.
+ * Playing grains are kept packed at the front of the arrays, so the synth walks them in a flat loop; starting and retiring a grain are O(1) <br>
+ */
+typedef struct grain_pool
+{
+    fixed_position      position[GRAIN_POOL_CAPACITY],              ///< read position of the current sample in the range of 0 - (soundfile length - 1) <br>
+                        increment[GRAIN_POOL_CAPACITY];             ///< advance of @a position per sample <br>
+    t_float             window_phase[GRAIN_POOL_CAPACITY],          ///< position within the grain window in the range of 0 - 1 <br>
+                        window_increment[GRAIN_POOL_CAPACITY],      ///< advance of @a window_phase per sample <br>
+                        amplitude[GRAIN_POOL_CAPACITY],             ///< amplitude of the grain <br>
+                        time_stretch_factor[GRAIN_POOL_CAPACITY],   ///< @a increment as float, picks the level of the soundfile pyramid <br>
+                        speed_offset[GRAIN_POOL_CAPACITY];          ///< added to the speed of the grain table, taken from the time stretch signal at the onset of the grain <br>
+    int                 remaining[GRAIN_POOL_CAPACITY],             ///< samples left until the grain has played all of its samples <br>
+                        played[GRAIN_POOL_CAPACITY],                ///< samples played since the grain started or restarted, unlike @a remaining not changed by @a grain_pool_fade <br>
+                        voice_index[GRAIN_POOL_CAPACITY],           ///< voice that started the grain <br>
+                        block_offset[GRAIN_POOL_CAPACITY];          ///< first sample of the current block the grain plays in, set by the density based scheduler <br>
+    t_float             start[GRAIN_POOL_CAPACITY],                 ///< starting point <br>
+                        end[GRAIN_POOL_CAPACITY];                   ///< ending point <br>
+    int                 grain_index[GRAIN_POOL_CAPACITY],           ///< index of the grain in the grain table, -1 for grains of the density based scheduler <br>
+                        grain_size_samples[GRAIN_POOL_CAPACITY];    ///< size of the grain in samples <br>
+    int                 num_active;                                 ///< number of playing grains <br>
+} grain_pool;
+
 /**
  * @brief generates new grain
  * @details generates new grain with @a grain_index according to set @a grain_size_samples, @a start_pos, @a time_stretch_factor based on @a soundfile_size
@@ -52,6 +83,96 @@ typedef struct grain
  */
 grain grain_new(int grain_size_samples, int soundfile_size, float start_pos, int grain_index, float time_stretch_factor);
 
+/**
+ * @brief empties the grain pool
+ * @param p pointer to the @a grain_pool <br>
+ */
+void grain_pool_clear(grain_pool *p);
+
+/**
+ * @brief starts a grain
+ * @details copies @a g into the slot behind the last playing grain <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param g grain to start <br>
+ * @param voice_index voice that starts the grain <br>
+ * @param block_offset first sample of the current block the grain plays in <br>
+ * @return int slot of the started grain, -1 if the pool is full <br>
+ */
+int grain_pool_start(grain_pool *p, const grain *g, int voice_index, int block_offset);
+
+/**
+ * @brief restarts a grain
+ * @details moves the grain back to its start position <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ */
+void grain_pool_restart(grain_pool *p, int i, int soundfile_size);
+
+/**
+ * @brief moves the read position of a grain
+ * @details shifts where the grain reads the soundfile, its place in the grain table and its playback range stay as they are <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param offset shift in samples <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ */
+void grain_pool_offset(grain_pool *p, int i, int offset, int soundfile_size);
+
+/**
+ * @brief changes the speed of a grain
+ * @details sets the @a time_stretch_factor of the grain and the fixed point @a increment derived from it <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param time_stretch_factor step size used from now on <br>
+ */
+void grain_pool_set_speed(grain_pool *p, int i, float time_stretch_factor);
+
+/**
+ * @brief advances a grain by several samples
+ * @details moves the grain the way @a num_samples calls of @a grain_process_sample would, used after a kernel rendered a span of the grain <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param num_samples number of samples the grain played <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ */
+void grain_pool_advance(grain_pool *p, int i, int num_samples, int soundfile_size);
+
+/**
+ * @brief fades a grain out early
+ * @details plays the falling half of the window within @a num_samples samples and ends the grain there, used when the grain would reach a part of the soundfile that is not loaded <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain <br>
+ * @param num_samples number of samples the grain can still play <br>
+ */
+void grain_pool_fade(grain_pool *p, int i, int num_samples);
+
+/**
+ * @brief retires a grain
+ * @details moves the last playing grain into the slot of the retired one, does not preserve the start order <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the grain to retire <br>
+ */
+void grain_pool_retire(grain_pool *p, int i);
+
+/**
+ * @brief takes over the grains of another pool
+ * @details moves every grain of @a from behind the playing grains of @a p with its state, grains that do not fit into @a p or started within the last @a started_within samples are dropped.
+ * Read positions are wrapped into a soundfile that may have become shorter <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param from pool whose grains are moved, empty afterwards <br>
+ * @param soundfile_size size of the soundfile in samples <br>
+ * @param started_within number of most recent samples whose grains are not taken over <br>
+ */
+void grain_pool_take_over(grain_pool *p, grain_pool *from, int soundfile_size, int started_within);
+
+/**
+ * @brief retires a grain and all grains started after it
+ * @details keeps the start order of the remaining grains <br>
+ * @param p pointer to the @a grain_pool <br>
+ * @param i slot of the first grain to retire <br>
+ */
+void grain_pool_truncate(grain_pool *p, int i);
 
 /**
  * @brief  frees grain
@@ -0,0 +1,668 @@
+/**
+ * @file grain_kernels.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief kernels that read, window and sum grains
+ * @details every kernel renders the samples of one grain span, the vector kernels handle 4 (SSE2), 8 (AVX2) or 16 (AVX-512) samples per instruction.
+ * Soundfiles stored in 16 bits are widened to float inside the kernels as they are read.
+ * The best kernel the CPU supports is picked at runtime, all other platforms use the scalar kernel <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include "grain_kernels.h"
+#include "purple_utils.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PURPLE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+static float sinc_table[(SINC_PHASES + 1) * SINC_TAPS];    ///< polyphase coefficients, one row of @a SINC_TAPS coefficients per fractional position <br>
+static pthread_once_t sinc_table_once = PTHREAD_ONCE_INIT;     ///< fills @a sinc_table once for the whole process <br>
+
+/**
+ * @brief fills the polyphase sinc table
+ * @details every row holds the coefficients of a blackman windowed sinc for one fractional position, normalized to a DC gain of 1 <br>
+ */
+static void grain_kernel_fill_sinc_table(void)
+{
+    for(int phase = 0; phase <= SINC_PHASES; phase++)
+    {
+        float *row = sinc_table + phase * SINC_TAPS;
+        double frac = (double)phase / SINC_PHASES;
+        double sum = 0;
+        for(int j = 0; j < SINC_TAPS; j++)
+        {
+            double x = (j - (SINC_TAPS / 2 - 1)) - frac;
+            double sinc = (x == 0) ? 1.0 : sin(M_PI * SINC_CUTOFF * x) / (M_PI * SINC_CUTOFF * x);
+            double window = 0.42 + 0.5 * cos(M_PI * x / (SINC_TAPS / 2)) + 0.08 * cos(2 * M_PI * x / (SINC_TAPS / 2));
+            row[j] = (float)(sinc * window);
+            sum += row[j];
+        }
+        for(int j = 0; j < SINC_TAPS; j++)
+        {
+            row[j] = (float)(row[j] / sum);
+        }
+    }
+}
+/**
+ * @brief prepares the kernels
+ * @details fills the sinc table shared by all instances exactly once, synths created on several threads at the same time wait until it is filled. Called when a synth is created <br>
+ */
+void grain_kernel_init(void)
+{
+    pthread_once(&sinc_table_once, grain_kernel_fill_sinc_table);
+}
+/**
+ * @brief reads the soundfile between two samples
+ * @details the interpolation points around the loop point are read from the guard samples of the table <br>
+ * @param soundfile soundfile table with guard samples <br>
+ * @param index sample left of the read position <br>
+ * @param frac position between sample @a index and the next one in the range of 0 - 1 <br>
+ * @param interpolation interpolation between the samples <br>
+ * @return float interpolated sample <br>
+ */
+float grain_kernel_read(const float *soundfile, int index, float frac, enum interpolation interpolation)
+{
+    switch(interpolation)
+    {
+        case INTERPOLATE_HERMITE:
+            return get_hermite_sample_value(soundfile[index - 1], soundfile[index], soundfile[index + 1], soundfile[index + 2], frac);
+        case INTERPOLATE_SINC:
+        {
+            const float *row = sinc_table + (int)(frac * SINC_PHASES + 0.5f) * SINC_TAPS;
+            const float *first = soundfile + index - (SINC_TAPS / 2 - 1);
+            float sum = 0;
+            for(int j = 0; j < SINC_TAPS; j++) sum += first[j] * row[j];
+            return sum;
+        }
+        default:
+            return get_interpolated_sample_value(soundfile[index], soundfile[index + 1], frac);
+    }
+}
+/**
+ * @brief widens a 16 bit sample to float
+ * @details a half float is rebuilt with integer operations only, subnormal halves are made from a normal float and a subtraction, so flushing denormals to zero does not silence quiet samples.
+ * Infinity and NaN are never stored <br>
+ * @param sample the stored sample <br>
+ * @param format @a SAMPLE_INT16 or @a SAMPLE_HALF <br>
+ * @return float value of the sample <br>
+ */
+float grain_kernel_widen(uint16_t sample, enum sample_format format)
+{
+    union { uint32_t bits; float value; } widened;
+
+    if(format == SAMPLE_INT16) return (int16_t)sample * (1.0f / 32768);
+    widened.bits = ((uint32_t)(sample & 0x7fff) << 13) + (112u << 23);
+    if(!(sample & 0x7c00))
+    {
+        widened.bits += 1u << 23;
+        widened.value -= 0x1p-14f;
+    }
+    return (sample & 0x8000) ? -widened.value : widened.value;
+}
+/**
+ * @brief reads a 16 bit soundfile between two samples
+ * @details widens the interpolation points and interpolates them like @a grain_kernel_read <br>
+ * @param soundfile 16 bit soundfile table with guard samples <br>
+ * @param format @a SAMPLE_INT16 or @a SAMPLE_HALF <br>
+ * @param index sample left of the read position <br>
+ * @param frac position between sample @a index and the next one in the range of 0 - 1 <br>
+ * @param interpolation interpolation between the samples <br>
+ * @return float interpolated sample <br>
+ */
+float grain_kernel_read_compact(const uint16_t *soundfile, enum sample_format format, int index, float frac, enum interpolation interpolation)
+{
+    const int center = SINC_TAPS / 2 - 1;
+    int before = (interpolation == INTERPOLATE_SINC) ? center : (interpolation == INTERPOLATE_HERMITE) ? 1 : 0;
+    int after = (interpolation == INTERPOLATE_SINC) ? SINC_TAPS / 2 : (interpolation == INTERPOLATE_HERMITE) ? 2 : 1;
+    float points[SINC_TAPS];
+
+    for(int j = -before; j <= after; j++)
+    {
+        points[center + j] = grain_kernel_widen(soundfile[index + j], format);
+    }
+    return grain_kernel_read(points + center, 0, frac, interpolation);
+}
+/**
+ * @brief number of samples until a span has to wrap around
+ * @param position read position in the range of 0 - @a wrap <br>
+ * @param step advance of the read position per sample <br>
+ * @param wrap read positions wrap around at this value <br>
+ * @param remaining number of samples left in the span <br>
+ * @return int number of samples that read the soundfile without wrapping, at most @a remaining <br>
+ */
+static inline int grain_kernel_segment_length(fixed_position position, fixed_position step, fixed_position wrap, int remaining)
+{
+    fixed_position n;
+    if(step > 0) n = (wrap - 1 - position) / step + 1;
+    else if(step < 0) n = position / -step + 1;
+    else return remaining;
+    return (n < remaining) ? (int)n : remaining;
+}
+/**
+ * @brief window value of a sample of a span
+ * @param s the span <br>
+ * @param k sample of the span <br>
+ * @return float interpolated value of the window table <br>
+ */
+static inline float grain_kernel_window_value(const grain_span *s, int k)
+{
+    float phase = s->window_phase + k * s->window_increment;
+    if(phase < 0) phase = 0;
+    if(phase > 1) phase = 1;
+    float window_position = phase * s->window_resolution;
+    int window_index = (int)window_position;
+    if(window_index > s->window_resolution - 1) window_index = s->window_resolution - 1;
+    float window_frac = window_position - window_index;
+    return s->window_table[window_index] * (1 - window_frac) + s->window_table[window_index + 1] * window_frac;
+}
+/**
+ * @brief renders samples of a span that do not wrap around
+ * @details also renders the remaining samples of the vector kernels <br>
+ * @param s the span <br>
+ * @param k first sample <br>
+ * @param end sample behind the last one <br>
+ * @param position read position of sample @a k <br>
+ */
+static void grain_kernel_scalar_segment(const grain_span *s, int k, int end, fixed_position position)
+{
+    for(; k < end; k++, position += s->step)
+    {
+        float sample = (s->format == SAMPLE_FLOAT32) ? grain_kernel_read(s->soundfile, fixed_index(position), fixed_frac(position), s->interpolation)
+                                                     : grain_kernel_read_compact(s->compact, s->format, fixed_index(position), fixed_frac(position), s->interpolation);
+        s->out[k] += sample * grain_kernel_window_value(s, k) * s->amplitude * s->voice_gain[k];
+    }
+}
+/**
+ * @brief splits a span into segments that do not wrap around
+ * @details the read position is wrapped once per segment instead of once per sample, a span wraps at most once unless the grain reads faster than the length of the soundfile per span <br>
+ * @param s the span <br>
+ * @param segment renders one segment <br>
+ */
+static inline void grain_kernel_split(const grain_span *s, void (*segment)(const grain_span *s, int k, int end, fixed_position position))
+{
+    if(s->wrap < FIXED_ONE) return;
+
+    fixed_position position = fixed_wrap(s->position, s->wrap);
+    int k = 0;
+    while(k < s->length)
+    {
+        int end = k + grain_kernel_segment_length(position, s->step, s->wrap, s->length - k);
+        segment(s, k, end, position);
+        position = fixed_wrap(position + (end - k) * s->step, s->wrap);
+        k = end;
+    }
+}
+/**
+ * @brief scalar kernel
+ * @param s the span <br>
+ */
+void grain_kernel_scalar(const grain_span *s)
+{
+    grain_kernel_split(s, grain_kernel_scalar_segment);
+}
+/**
+ * @brief wraps the index of an interpolation point into the soundfile
+ * @param index index of the point, may lie a few samples outside of the soundfile <br>
+ * @param wrap_index soundfile length - 1 <br>
+ * @return int index in the range of 0 - @a wrap_index <br>
+ */
+static inline int grain_kernel_wrap_index(int index, int wrap_index)
+{
+    while(index < 0) index += wrap_index;
+    while(index > wrap_index) index -= wrap_index;
+    return index;
+}
+/**
+ * @brief reads one sample of a strided soundfile
+ * @param samples first sample <br>
+ * @param stride distance between two samples in floats <br>
+ * @param wrap_index soundfile length - 1, at least 1 <br>
+ * @param index index of the sample, may lie a few samples outside of the soundfile <br>
+ * @return float the sample @a index is wrapped to <br>
+ */
+static inline float grain_kernel_strided_sample(const float *samples, int stride, int wrap_index, int index)
+{
+    return samples[(size_t)grain_kernel_wrap_index(index, wrap_index) * stride];
+}
+/**
+ * @brief reads a strided soundfile between two samples
+ * @details for soundfiles without guard samples that are read in place, e.g. the words of a pd array. Every interpolation point is wrapped into the soundfile on its own <br>
+ * @param samples first sample <br>
+ * @param stride distance between two samples in floats <br>
+ * @param wrap_index soundfile length - 1, at least 1 <br>
+ * @param index sample left of the read position in the range of 0 - @a wrap_index <br>
+ * @param frac position between sample @a index and the next one in the range of 0 - 1 <br>
+ * @param interpolation interpolation between the samples <br>
+ * @return float interpolated sample <br>
+ */
+float grain_kernel_read_strided(const float *samples, int stride, int wrap_index, int index, float frac, enum interpolation interpolation)
+{
+    switch(interpolation)
+    {
+        case INTERPOLATE_HERMITE:
+            return get_hermite_sample_value(grain_kernel_strided_sample(samples, stride, wrap_index, index - 1),
+                                            grain_kernel_strided_sample(samples, stride, wrap_index, index),
+                                            grain_kernel_strided_sample(samples, stride, wrap_index, index + 1),
+                                            grain_kernel_strided_sample(samples, stride, wrap_index, index + 2),
+                                            frac);
+        case INTERPOLATE_SINC:
+        {
+            const float *row = sinc_table + (int)(frac * SINC_PHASES + 0.5f) * SINC_TAPS;
+            int first = index - (SINC_TAPS / 2 - 1);
+            float sum = 0;
+            for(int j = 0; j < SINC_TAPS; j++) sum += grain_kernel_strided_sample(samples, stride, wrap_index, first + j) * row[j];
+            return sum;
+        }
+        default:
+            return get_interpolated_sample_value(grain_kernel_strided_sample(samples, stride, wrap_index, index),
+                                                 grain_kernel_strided_sample(samples, stride, wrap_index, index + 1),
+                                                 frac);
+    }
+}
+/**
+ * @brief renders samples of a strided span that do not wrap around
+ * @param s the span <br>
+ * @param k first sample <br>
+ * @param end sample behind the last one <br>
+ * @param position read position of sample @a k <br>
+ */
+static void grain_kernel_strided_segment(const grain_span *s, int k, int end, fixed_position position)
+{
+    const int wrap_index = fixed_index(s->wrap);
+    
+    for(; k < end; k++, position += s->step)
+    {
+        float sample = grain_kernel_read_strided(s->soundfile, s->stride, wrap_index, fixed_index(position), fixed_frac(position), s->interpolation);
+        s->out[k] += sample * grain_kernel_window_value(s, k) * s->amplitude * s->voice_gain[k];
+    }
+}
+/**
+ * @brief scalar kernel for soundfiles read in place
+ * @details reads @a soundfile with @a stride and wraps every interpolation point, needs no guard samples <br>
+ * @param s the span <br>
+ */
+void grain_kernel_strided(const grain_span *s)
+{
+    grain_kernel_split(s, grain_kernel_strided_segment);
+}
+
+#ifdef PURPLE_X86_KERNELS
+/**
+ * @brief renders a segment with SSE2, 4 samples per instruction
+ * @details SSE2 has neither gather nor floor, indices are stored and loaded one by one and floor is done by truncation.
+ * Only linear interpolation of float samples is vectorized, the other interpolations and 16 bit samples use the scalar kernel.
+ * The lanes are computed relative to the read position of sample @a k, rounding errors can move an index one sample outside of the soundfile, which reads a guard sample <br>
+ * @param s the span <br>
+ * @param k first sample <br>
+ * @param end sample behind the last one <br>
+ * @param position read position of sample @a k <br>
+ */
+__attribute__((target("sse2")))
+static void grain_kernel_sse2_segment(const grain_span *s, int k, int end, fixed_position position)
+{
+    if(s->interpolation != INTERPOLATE_LINEAR || s->format != SAMPLE_FLOAT32)
+    {
+        grain_kernel_scalar_segment(s, k, end, position);
+        return;
+    }
+
+    const __m128 lanes = _mm_set_ps(3, 2, 1, 0);
+    const __m128 one = _mm_set1_ps(1), zero = _mm_setzero_ps();
+    const __m128 resolution = _mm_set1_ps((float)s->window_resolution);
+    const __m128i last_window_index = _mm_set1_epi32(s->window_resolution - 1);
+    const __m128 amplitude = _mm_set1_ps(s->amplitude);
+    const __m128i index0 = _mm_set1_epi32(fixed_index(position));
+    const __m128 frac0 = _mm_set1_ps(fixed_frac(position)), step = _mm_set1_ps((float)((double)s->step / FIXED_ONE));
+    const __m128 phase0 = _mm_set1_ps(s->window_phase), increment = _mm_set1_ps(s->window_increment);
+    const float *soundfile = s->soundfile, *window_table = s->window_table, *voice_gain = s->voice_gain;
+    float *out = s->out;
+    const int first = k;
+    int index[4], window_index[4];
+
+    for(; k + 4 <= end; k += 4)
+    {
+        __m128 kf = _mm_add_ps(_mm_set1_ps((float)k), lanes);
+        __m128 rf = _mm_add_ps(_mm_set1_ps((float)(k - first)), lanes);
+
+        __m128 offset = _mm_add_ps(frac0, _mm_mul_ps(rf, step));
+        __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(offset));
+        whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, offset), one));
+        __m128 frac = _mm_sub_ps(offset, whole);
+        _mm_storeu_si128((__m128i *)index, _mm_add_epi32(index0, _mm_cvttps_epi32(whole)));
+        __m128 left = _mm_set_ps(soundfile[index[3]], soundfile[index[2]], soundfile[index[1]], soundfile[index[0]]);
+        __m128 right = _mm_set_ps(soundfile[index[3] + 1], soundfile[index[2] + 1], soundfile[index[1] + 1], soundfile[index[0] + 1]);
+        __m128 sample = _mm_add_ps(_mm_mul_ps(left, _mm_sub_ps(one, frac)), _mm_mul_ps(right, frac));
+
+        __m128 phase = _mm_add_ps(phase0, _mm_mul_ps(kf, increment));
+        phase = _mm_min_ps(_mm_max_ps(phase, zero), one);
+        __m128 window_position = _mm_mul_ps(phase, resolution);
+        __m128i wi = _mm_cvttps_epi32(window_position);
+        __m128i over = _mm_cmpgt_epi32(wi, last_window_index);
+        wi = _mm_or_si128(_mm_andnot_si128(over, wi), _mm_and_si128(over, last_window_index));
+        __m128 window_frac = _mm_sub_ps(window_position, _mm_cvtepi32_ps(wi));
+        _mm_storeu_si128((__m128i *)window_index, wi);
+        left = _mm_set_ps(window_table[window_index[3]], window_table[window_index[2]], window_table[window_index[1]], window_table[window_index[0]]);
+        right = _mm_set_ps(window_table[window_index[3] + 1], window_table[window_index[2] + 1], window_table[window_index[1] + 1], window_table[window_index[0] + 1]);
+        __m128 window_value = _mm_add_ps(_mm_mul_ps(left, _mm_sub_ps(one, window_frac)), _mm_mul_ps(right, window_frac));
+
+        __m128 gain = _mm_mul_ps(_mm_mul_ps(window_value, amplitude), _mm_loadu_ps(voice_gain + k));
+        _mm_storeu_ps(out + k, _mm_add_ps(_mm_loadu_ps(out + k), _mm_mul_ps(sample, gain)));
+    }
+    grain_kernel_scalar_segment(s, k, end, position + (k - first) * s->step);
+}
+/**
+ * @brief SSE2 kernel, 4 samples per instruction
+ * @param s the span <br>
+ */
+__attribute__((target("sse2")))
+static void grain_kernel_sse2(const grain_span *s)
+{
+    grain_kernel_split(s, grain_kernel_sse2_segment);
+}
+/**
+ * @brief widens 16 bit samples to float
+ * @details the inverse of the conversion at load time, see @a grain_kernel_widen <br>
+ * @param h samples in the lower 16 bits of every lane, the upper bits are ignored <br>
+ * @param format @a SAMPLE_INT16 or @a SAMPLE_HALF <br>
+ * @return __m256 the samples as float <br>
+ */
+__attribute__((target("avx2,fma"), always_inline))
+static inline __m256 grain_kernel_avx2_widen(__m256i h, enum sample_format format)
+{
+    if(format == SAMPLE_INT16) return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(h, 16), 16)), _mm256_set1_ps(1.0f / 32768));
+
+    __m256i subnormal = _mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x7c00)), _mm256_setzero_si256());
+    __m256i bits = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x7fff)), 13), _mm256_set1_epi32(112 << 23));
+    bits = _mm256_add_epi32(bits, _mm256_and_si256(subnormal, _mm256_set1_epi32(1 << 23)));
+    __m256 value = _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_and_ps(_mm256_castsi256_ps(subnormal), _mm256_set1_ps(0x1p-14f)));
+    return _mm256_or_ps(value, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16)));
+}
+/**
+ * @brief reads the interpolation points of 8 samples
+ * @details a 16 bit soundfile is gathered in pairs of neighbouring samples, one 32 bit gather fetches two interpolation points and touches half the memory of a float gather <br>
+ * @param s the span <br>
+ * @param i samples left of the read positions <br>
+ * @param first offset of the first point from @a i <br>
+ * @param count number of points, even for a 16 bit soundfile <br>
+ * @param points the points <br>
+ */
+__attribute__((target("avx2,fma"), always_inline))
+static inline void grain_kernel_avx2_points(const grain_span *s, __m256i i, int first, int count, __m256 *points)
+{
+    if(s->format == SAMPLE_FLOAT32)
+    {
+        for(int j = 0; j < count; j++) points[j] = _mm256_i32gather_ps(s->soundfile + first + j, i, 4);
+        return;
+    }
+    for(int j = 0; j < count; j += 2)
+    {
+        __m256i pair = _mm256_i32gather_epi32((const int *)(s->compact + first + j), i, 2);
+        points[j] = grain_kernel_avx2_widen(pair, s->format);
+        points[j + 1] = grain_kernel_avx2_widen(_mm256_srli_epi32(pair, 16), s->format);
+    }
+}
+/**
+ * @brief reads 8 interpolated samples of the soundfile
+ * @param s the span <br>
+ * @param i samples left of the read positions <br>
+ * @param frac positions between sample @a i and the next one <br>
+ * @return __m256 interpolated samples <br>
+ */
+__attribute__((target("avx2,fma"), always_inline))
+static inline __m256 grain_kernel_avx2_read(const grain_span *s, __m256i i, __m256 frac)
+{
+    __m256 points[SINC_TAPS];
+
+    switch(s->interpolation)
+    {
+        case INTERPOLATE_HERMITE:
+        {
+            grain_kernel_avx2_points(s, i, -1, 4, points);
+            __m256 before = points[0], left = points[1], right = points[2], after = points[3];
+            __m256 c1 = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_sub_ps(right, before));
+            __m256 c2 = _mm256_fmadd_ps(_mm256_set1_ps(-2.5f), left, _mm256_fmadd_ps(_mm256_set1_ps(2.0f), right, _mm256_fmadd_ps(_mm256_set1_ps(-0.5f), after, before)));
+            __m256 c3 = _mm256_fmadd_ps(_mm256_set1_ps(0.5f), _mm256_sub_ps(after, before), _mm256_mul_ps(_mm256_set1_ps(1.5f), _mm256_sub_ps(left, right)));
+            return _mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_fmadd_ps(c3, frac, c2), frac, c1), frac, left);
+        }
+        case INTERPOLATE_SINC:
+        {
+            __m256i row = _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_fmadd_ps(frac, _mm256_set1_ps(SINC_PHASES), _mm256_set1_ps(0.5f))), 3);
+            __m256 sum = _mm256_setzero_ps();
+            grain_kernel_avx2_points(s, i, -(SINC_TAPS / 2 - 1), SINC_TAPS, points);
+            for(int j = 0; j < SINC_TAPS; j++)
+            {
+                sum = _mm256_fmadd_ps(points[j], _mm256_i32gather_ps(sinc_table + j, row, 4), sum);
+            }
+            return sum;
+        }
+        default:
+        {
+            grain_kernel_avx2_points(s, i, 0, 2, points);
+            return _mm256_fmadd_ps(points[1], frac, _mm256_mul_ps(points[0], _mm256_sub_ps(_mm256_set1_ps(1), frac)));
+        }
+    }
+}
+/**
+ * @brief renders a segment with AVX2, 8 samples per instruction
+ * @details the lanes are computed relative to the read position of sample @a k, rounding errors can move an index one sample outside of the soundfile, which reads a guard sample <br>
+ * @param s the span <br>
+ * @param k first sample <br>
+ * @param end sample behind the last one <br>
+ * @param position read position of sample @a k <br>
+ */
+__attribute__((target("avx2,fma")))
+static void grain_kernel_avx2_segment(const grain_span *s, int k, int end, fixed_position position)
+{
+    const __m256 lanes = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256 one = _mm256_set1_ps(1), zero = _mm256_setzero_ps();
+    const __m256 resolution = _mm256_set1_ps((float)s->window_resolution);
+    const __m256i last_window_index = _mm256_set1_epi32(s->window_resolution - 1);
+    const __m256 amplitude = _mm256_set1_ps(s->amplitude);
+    const __m256i index0 = _mm256_set1_epi32(fixed_index(position));
+    const __m256 frac0 = _mm256_set1_ps(fixed_frac(position)), step = _mm256_set1_ps((float)((double)s->step / FIXED_ONE));
+    const __m256 phase0 = _mm256_set1_ps(s->window_phase), increment = _mm256_set1_ps(s->window_increment);
+    const float *window_table = s->window_table, *voice_gain = s->voice_gain;
+    float *out = s->out;
+    const int first = k;
+
+    for(; k + 8 <= end; k += 8)
+    {
+        __m256 kf = _mm256_add_ps(_mm256_set1_ps((float)k), lanes);
+        __m256 rf = _mm256_add_ps(_mm256_set1_ps((float)(k - first)), lanes);
+
+        __m256 offset = _mm256_fmadd_ps(rf, step, frac0);
+        __m256 whole = _mm256_floor_ps(offset);
+        __m256i i = _mm256_add_epi32(index0, _mm256_cvttps_epi32(whole));
+        __m256 sample = grain_kernel_avx2_read(s, i, _mm256_sub_ps(offset, whole));
+
+        __m256 phase = _mm256_fmadd_ps(kf, increment, phase0);
+        phase = _mm256_min_ps(_mm256_max_ps(phase, zero), one);
+        __m256 window_position = _mm256_mul_ps(phase, resolution);
+        __m256i wi = _mm256_min_epi32(_mm256_cvttps_epi32(window_position), last_window_index);
+        __m256 window_frac = _mm256_sub_ps(window_position, _mm256_cvtepi32_ps(wi));
+        __m256 left = _mm256_i32gather_ps(window_table, wi, 4);
+        __m256 right = _mm256_i32gather_ps(window_table + 1, wi, 4);
+        __m256 window_value = _mm256_fmadd_ps(right, window_frac, _mm256_mul_ps(left, _mm256_sub_ps(one, window_frac)));
+
+        __m256 gain = _mm256_mul_ps(_mm256_mul_ps(window_value, amplitude), _mm256_loadu_ps(voice_gain + k));
+        _mm256_storeu_ps(out + k, _mm256_fmadd_ps(sample, gain, _mm256_loadu_ps(out + k)));
+    }
+    _mm256_zeroupper();
+    grain_kernel_scalar_segment(s, k, end, position + (k - first) * s->step);
+}
+/**
+ * @brief AVX2 kernel, 8 samples per instruction
+ * @param s the span <br>
+ */
+__attribute__((target("avx2,fma")))
+static void grain_kernel_avx2(const grain_span *s)
+{
+    grain_kernel_split(s, grain_kernel_avx2_segment);
+}
+/**
+ * @brief widens 16 bit samples to float
+ * @details the inverse of the conversion at load time, see @a grain_kernel_widen <br>
+ * @param h samples in the lower 16 bits of every lane, the upper bits are ignored <br>
+ * @param format @a SAMPLE_INT16 or @a SAMPLE_HALF <br>
+ * @return __m512 the samples as float <br>
+ */
+__attribute__((target("avx512f"), always_inline))
+static inline __m512 grain_kernel_avx512_widen(__m512i h, enum sample_format format)
+{
+    if(format == SAMPLE_INT16) return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(_mm512_slli_epi32(h, 16), 16)), _mm512_set1_ps(1.0f / 32768));
+
+    __mmask16 subnormal = _mm512_testn_epi32_mask(h, _mm512_set1_epi32(0x7c00));
+    __m512i bits = _mm512_add_epi32(_mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(0x7fff)), 13), _mm512_set1_epi32(112 << 23));
+    bits = _mm512_mask_add_epi32(bits, subnormal, bits, _mm512_set1_epi32(1 << 23));
+    __m512 value = _mm512_mask_sub_ps(_mm512_castsi512_ps(bits), subnormal, _mm512_castsi512_ps(bits), _mm512_set1_ps(0x1p-14f));
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(value), _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(0x8000)), 16)));
+}
+/**
+ * @brief reads the interpolation points of 16 samples
+ * @details a 16 bit soundfile is gathered in pairs of neighbouring samples, one 32 bit gather fetches two interpolation points and touches half the memory of a float gather <br>
+ * @param s the span <br>
+ * @param i samples left of the read positions <br>
+ * @param first offset of the first point from @a i <br>
+ * @param count number of points, even for a 16 bit soundfile <br>
+ * @param points the points <br>
+ */
+__attribute__((target("avx512f"), always_inline))
+static inline void grain_kernel_avx512_points(const grain_span *s, __m512i i, int first, int count, __m512 *points)
+{
+    if(s->format == SAMPLE_FLOAT32)
+    {
+        for(int j = 0; j < count; j++) points[j] = _mm512_i32gather_ps(i, s->soundfile + first + j, 4);
+        return;
+    }
+    for(int j = 0; j < count; j += 2)
+    {
+        __m512i pair = _mm512_i32gather_epi32(i, s->compact + first + j, 2);
+        points[j] = grain_kernel_avx512_widen(pair, s->format);
+        points[j + 1] = grain_kernel_avx512_widen(_mm512_srli_epi32(pair, 16), s->format);
+    }
+}
+/**
+ * @brief reads 16 interpolated samples of the soundfile
+ * @param s the span <br>
+ * @param i samples left of the read positions <br>
+ * @param frac positions between sample @a i and the next one <br>
+ * @return __m512 interpolated samples <br>
+ */
+__attribute__((target("avx512f"), always_inline))
+static inline __m512 grain_kernel_avx512_read(const grain_span *s, __m512i i, __m512 frac)
+{
+    __m512 points[SINC_TAPS];
+
+    switch(s->interpolation)
+    {
+        case INTERPOLATE_HERMITE:
+        {
+            grain_kernel_avx512_points(s, i, -1, 4, points);
+            __m512 before = points[0], left = points[1], right = points[2], after = points[3];
+            __m512 c1 = _mm512_mul_ps(_mm512_set1_ps(0.5f), _mm512_sub_ps(right, before));
+            __m512 c2 = _mm512_fmadd_ps(_mm512_set1_ps(-2.5f), left, _mm512_fmadd_ps(_mm512_set1_ps(2.0f), right, _mm512_fmadd_ps(_mm512_set1_ps(-0.5f), after, before)));
+            __m512 c3 = _mm512_fmadd_ps(_mm512_set1_ps(0.5f), _mm512_sub_ps(after, before), _mm512_mul_ps(_mm512_set1_ps(1.5f), _mm512_sub_ps(left, right)));
+            return _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_fmadd_ps(c3, frac, c2), frac, c1), frac, left);
+        }
+        case INTERPOLATE_SINC:
+        {
+            __m512i row = _mm512_slli_epi32(_mm512_cvttps_epi32(_mm512_fmadd_ps(frac, _mm512_set1_ps(SINC_PHASES), _mm512_set1_ps(0.5f))), 3);
+            __m512 sum = _mm512_setzero_ps();
+            grain_kernel_avx512_points(s, i, -(SINC_TAPS / 2 - 1), SINC_TAPS, points);
+            for(int j = 0; j < SINC_TAPS; j++)
+            {
+                sum = _mm512_fmadd_ps(points[j], _mm512_i32gather_ps(row, sinc_table + j, 4), sum);
+            }
+            return sum;
+        }
+        default:
+        {
+            grain_kernel_avx512_points(s, i, 0, 2, points);
+            return _mm512_fmadd_ps(points[1], frac, _mm512_mul_ps(points[0], _mm512_sub_ps(_mm512_set1_ps(1), frac)));
+        }
+    }
+}
+/**
+ * @brief renders a segment with AVX-512, 16 samples per instruction
+ * @details the lanes are computed relative to the read position of sample @a k, rounding errors can move an index one sample outside of the soundfile, which reads a guard sample <br>
+ * @param s the span <br>
+ * @param k first sample <br>
+ * @param end sample behind the last one <br>
+ * @param position read position of sample @a k <br>
+ */
+__attribute__((target("avx512f")))
+static void grain_kernel_avx512_segment(const grain_span *s, int k, int end, fixed_position position)
+{
+    const __m512 lanes = _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512 one = _mm512_set1_ps(1), zero = _mm512_setzero_ps();
+    const __m512 resolution = _mm512_set1_ps((float)s->window_resolution);
+    const __m512i last_window_index = _mm512_set1_epi32(s->window_resolution - 1);
+    const __m512 amplitude = _mm512_set1_ps(s->amplitude);
+    const __m512i index0 = _mm512_set1_epi32(fixed_index(position));
+    const __m512 frac0 = _mm512_set1_ps(fixed_frac(position)), step = _mm512_set1_ps((float)((double)s->step / FIXED_ONE));
+    const __m512 phase0 = _mm512_set1_ps(s->window_phase), increment = _mm512_set1_ps(s->window_increment);
+    const float *window_table = s->window_table, *voice_gain = s->voice_gain;
+    float *out = s->out;
+    const int first = k;
+
+    for(; k + 16 <= end; k += 16)
+    {
+        __m512 kf = _mm512_add_ps(_mm512_set1_ps((float)k), lanes);
+        __m512 rf = _mm512_add_ps(_mm512_set1_ps((float)(k - first)), lanes);
+
+        __m512 offset = _mm512_fmadd_ps(rf, step, frac0);
+        __m512 whole = _mm512_roundscale_ps(offset, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        __m512i i = _mm512_add_epi32(index0, _mm512_cvttps_epi32(whole));
+        __m512 sample = grain_kernel_avx512_read(s, i, _mm512_sub_ps(offset, whole));
+
+        __m512 phase = _mm512_fmadd_ps(kf, increment, phase0);
+        phase = _mm512_min_ps(_mm512_max_ps(phase, zero), one);
+        __m512 window_position = _mm512_mul_ps(phase, resolution);
+        __m512i wi = _mm512_min_epi32(_mm512_cvttps_epi32(window_position), last_window_index);
+        __m512 window_frac = _mm512_sub_ps(window_position, _mm512_cvtepi32_ps(wi));
+        __m512 left = _mm512_i32gather_ps(wi, window_table, 4);
+        __m512 right = _mm512_i32gather_ps(wi, window_table + 1, 4);
+        __m512 window_value = _mm512_fmadd_ps(right, window_frac, _mm512_mul_ps(left, _mm512_sub_ps(one, window_frac)));
+
+        __m512 gain = _mm512_mul_ps(_mm512_mul_ps(window_value, amplitude), _mm512_loadu_ps(voice_gain + k));
+        _mm512_storeu_ps(out + k, _mm512_fmadd_ps(sample, gain, _mm512_loadu_ps(out + k)));
+    }
+    _mm256_zeroupper();
+    grain_kernel_scalar_segment(s, k, end, position + (k - first) * s->step);
+}
+/**
+ * @brief AVX-512 kernel, 16 samples per instruction
+ * @param s the span <br>
+ */
+__attribute__((target("avx512f")))
+static void grain_kernel_avx512(const grain_span *s)
+{
+    grain_kernel_split(s, grain_kernel_avx512_segment);
+}
+#endif
+
+/**
+ * @brief picks the fastest kernel of the CPU
+ * @return grain_span_kernel AVX-512, AVX2, SSE2 or scalar kernel <br>
+ */
+grain_span_kernel grain_kernel_select(void)
+{
+#ifdef PURPLE_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return grain_kernel_avx512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return grain_kernel_avx2;
+    if(__builtin_cpu_supports("sse2")) return grain_kernel_sse2;
+#endif
+    return grain_kernel_scalar;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file grain_kernels.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a grain_kernels.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef grain_kernels_h
+#define grain_kernels_h
+
+#include <stdint.h>
+#include "purple_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SINC_TAPS 8                             ///< number of samples the windowed sinc interpolator reads, 3 before and 4 after the read position <br>
+#define SINC_PHASES 512                         ///< number of fractional positions of the polyphase sinc table <br>
+#define SINC_CUTOFF 0.9f                        ///< cutoff of the sinc interpolator relative to the nyquist frequency <br>
+
+/**
+ * @brief interpolation between the samples of the soundfile
+ */
+enum interpolation {
+    INTERPOLATE_LINEAR,                         ///< 2 point linear interpolation <br>
+    INTERPOLATE_HERMITE,                        ///< 4 point, 3rd order hermite interpolation <br>
+    INTERPOLATE_SINC                            ///< 8 point windowed sinc interpolation from a polyphase table <br>
+};
+
+/**
+ * @brief format the samples of the soundfile are stored in
+ */
+enum sample_format {
+    SAMPLE_FLOAT32,                             ///< 32 bit float <br>
+    SAMPLE_INT16,                               ///< 16 bit signed integer, full scale is 1 <br>
+    SAMPLE_HALF                                 ///< IEEE 754 16 bit float <br>
+};
+
+/**
+ * @struct grain_span
+ * @brief one grain played over a run of output samples
+ * @details everything a kernel needs to read, window, weight and sum @a length samples of one grain. Sample @a k of the span reads the soundfile at the fixed point position @a position + k * @a step, wrapped into 0 - @a wrap, and the window at @a window_phase + k * @a window_increment <br>
+ */
+typedef struct grain_span
+{
+    const float *soundfile;                     ///< soundfile table of the synth or a level of its pyramid, with guard samples <br>
+    const uint16_t *compact;                    ///< the same samples stored in 16 bits, read instead of @a soundfile unless @a format is @a SAMPLE_FLOAT32 <br>
+    const float *window_table;                  ///< window table with @a window_resolution + 1 points <br>
+    const float *voice_gain;                    ///< ADSR value of the grain's voice for every sample of the span <br>
+    float       *out;                           ///< output samples the grain is added to <br>
+    enum interpolation interpolation;           ///< interpolation between the samples of the soundfile <br>
+    enum sample_format format;                  ///< format of the samples, the kernels widen 16 bit samples to float while they read them <br>
+    int         length,                         ///< number of samples of the span <br>
+                window_resolution,              ///< number of table points per window period <br>
+                stride;                         ///< distance between two samples of @a soundfile in floats, only read by @a grain_kernel_strided, all other kernels expect 1 <br>
+    fixed_position  wrap,                       ///< read positions wrap around at this value, soundfile length - 1 <br>
+                    position,                   ///< read position of the first sample <br>
+                    step;                       ///< advance of the read position per sample <br>
+    float       window_phase,                   ///< window phase of the first sample <br>
+                window_increment,               ///< advance of the window phase per sample <br>
+                amplitude;                      ///< amplitude of the grain <br>
+} grain_span;
+
+/**
+ * @brief renders a @a grain_span
+ * @param s the span <br>
+ */
+typedef void (*grain_span_kernel)(const grain_span *s);
+
+void grain_kernel_init(void);
+float grain_kernel_read(const float *soundfile, int index, float frac, enum interpolation interpolation);
+float grain_kernel_widen(uint16_t sample, enum sample_format format);
+float grain_kernel_read_compact(const uint16_t *soundfile, enum sample_format format, int index, float frac, enum interpolation interpolation);
+grain_span_kernel grain_kernel_select(void);
+void grain_kernel_scalar(const grain_span *s);
+float grain_kernel_read_strided(const float *samples, int stride, int wrap_index, int index, float frac, enum interpolation interpolation);
+void grain_kernel_strided(const grain_span *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * @file mapped_soundfile.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief memory mapped WAV and AIFF files
+ * @details maps a soundfile read only and finds its sample frames, nothing is read or converted while opening. WAV (PCM, IEEE float and extensible), AIFF and AIFC (NONE, twos, sowt, fl32, fl64) with 16, 24 and 32 bit integer or 32 and 64 bit float samples are understood <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mapped_soundfile.h"
+
+/**
+ * @brief reads an unsigned 16 bit value
+ * @param p first byte <br>
+ * @param big_endian byte order <br>
+ * @return uint16_t the value <br>
+ */
+static uint16_t mapped_soundfile_u16(const unsigned char *p, bool big_endian)
+{
+    return big_endian ? (uint16_t)(p[0] << 8 | p[1]) : (uint16_t)(p[1] << 8 | p[0]);
+}
+/**
+ * @brief reads an unsigned 32 bit value
+ * @param p first byte <br>
+ * @param big_endian byte order <br>
+ * @return uint32_t the value <br>
+ */
+static uint32_t mapped_soundfile_u32(const unsigned char *p, bool big_endian)
+{
+    if(big_endian) return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+/**
+ * @brief reads an unsigned 64 bit value
+ * @param p first byte <br>
+ * @param big_endian byte order <br>
+ * @return uint64_t the value <br>
+ */
+static uint64_t mapped_soundfile_u64(const unsigned char *p, bool big_endian)
+{
+    uint64_t high = mapped_soundfile_u32(big_endian ? p : p + 4, big_endian),
+             low = mapped_soundfile_u32(big_endian ? p + 4 : p, big_endian);
+    return high << 32 | low;
+}
+/**
+ * @brief reads the 80 bit extended float AIFF stores the samplerate in
+ * @param p first byte <br>
+ * @return double the value <br>
+ */
+static double mapped_soundfile_extended(const unsigned char *p)
+{
+    int exponent = (p[0] & 0x7f) << 8 | p[1];
+    uint64_t mantissa = mapped_soundfile_u64(p + 2, true);
+    double value;
+
+    if(exponent == 0 && mantissa == 0) return 0;
+    value = ldexp((double)mantissa, exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -value : value;
+}
+/**
+ * @brief sets the sample format
+ * @param f the file <br>
+ * @param num_channels number of channels <br>
+ * @param bits bits per sample <br>
+ * @param is_float true for IEEE float samples <br>
+ * @return true if the format is understood <br>
+ */
+static bool mapped_soundfile_set_format(mapped_soundfile *f, int num_channels, int bits, bool is_float)
+{
+    f->bytes_per_sample = (bits + 7) / 8;
+    if(is_float && f->bytes_per_sample == 4) f->format = MAPPED_FLOAT32;
+    else if(is_float && f->bytes_per_sample == 8) f->format = MAPPED_FLOAT64;
+    else if(!is_float && f->bytes_per_sample == 2) f->format = MAPPED_INT16;
+    else if(!is_float && f->bytes_per_sample == 3) f->format = MAPPED_INT24;
+    else if(!is_float && f->bytes_per_sample == 4) f->format = MAPPED_INT32;
+    else return false;
+
+    f->num_channels = num_channels;
+    f->frame_size = num_channels * f->bytes_per_sample;
+    return num_channels > 0;
+}
+/**
+ * @brief sets the sample frames
+ * @details a data chunk that claims more bytes than the file holds, as left behind by an interrupted recording, is cut to the file, and sample data starting past the end of the file holds no frames <br>
+ * @param f the file <br>
+ * @param data first sample frame <br>
+ * @param size size of the sample data in bytes <br>
+ * @param max_frames number of frames stated by the header, -1 if the header states none <br>
+ */
+static void mapped_soundfile_set_frames(mapped_soundfile *f, const unsigned char *data, size_t size, int64_t max_frames)
+{
+    const unsigned char *end = (const unsigned char *)f->map + f->map_size;
+    size_t available = (data < end) ? (size_t)(end - data) : 0;
+    int64_t num_frames;
+
+    if(size > available) size = available;
+    num_frames = size / f->frame_size;
+    if(max_frames >= 0 && num_frames > max_frames) num_frames = max_frames;
+    if(num_frames > INT_MAX) num_frames = INT_MAX;
+    f->data = data;
+    f->num_frames = (int)num_frames;
+}
+/**
+ * @brief finds the format and the sample frames of a WAV file
+ * @param f the file with its mapping <br>
+ * @return true if the file can be played <br>
+ */
+static bool mapped_soundfile_parse_wav(mapped_soundfile *f)
+{
+    const unsigned char *p = (const unsigned char *)f->map,
+                        *data = NULL;
+    size_t position = 12,
+           data_size = 0;
+    bool has_format = false;
+
+    f->big_endian = false;
+    while(position + 8 <= f->map_size)
+    {
+        const unsigned char *chunk = p + position,
+                            *body = chunk + 8;
+        size_t size = mapped_soundfile_u32(chunk + 4, false),
+               available = f->map_size - position - 8;
+
+        if(!memcmp(chunk, "fmt ", 4) && size >= 16 && size <= available)
+        {
+            int tag = mapped_soundfile_u16(body, false);
+            if(tag == 0xfffe && size >= 26) tag = mapped_soundfile_u16(body + 24, false);
+            if(tag != 1 && tag != 3) return false;
+            if(!mapped_soundfile_set_format(f, mapped_soundfile_u16(body + 2, false), mapped_soundfile_u16(body + 14, false), tag == 3)) return false;
+            f->samplerate = mapped_soundfile_u32(body + 4, false);
+            has_format = true;
+        }
+        else if(!memcmp(chunk, "data", 4))
+        {
+            data = body;
+            data_size = size;
+        }
+        position += 8 + size + (size & 1);
+    }
+    if(!has_format || !data) return false;
+
+    mapped_soundfile_set_frames(f, data, data_size, -1);
+    return true;
+}
+/**
+ * @brief finds the format and the sample frames of an AIFF or AIFC file
+ * @param f the file with its mapping <br>
+ * @param aifc true for AIFC, which names its compression type <br>
+ * @return true if the file can be played <br>
+ */
+static bool mapped_soundfile_parse_aiff(mapped_soundfile *f, bool aifc)
+{
+    const unsigned char *p = (const unsigned char *)f->map,
+                        *data = NULL;
+    size_t position = 12,
+           data_size = 0;
+    int64_t num_frames = -1;
+
+    f->big_endian = true;
+    while(position + 8 <= f->map_size)
+    {
+        const unsigned char *chunk = p + position,
+                            *body = chunk + 8;
+        size_t size = mapped_soundfile_u32(chunk + 4, true),
+               available = f->map_size - position - 8;
+
+        if(!memcmp(chunk, "COMM", 4) && size >= 18 && size <= available)
+        {
+            int bits = mapped_soundfile_u16(body + 6, true);
+            bool is_float = false;
+            if(aifc && size >= 22)
+            {
+                const unsigned char *compression = body + 18;
+                if(!memcmp(compression, "sowt", 4)) f->big_endian = false;
+                else if(!memcmp(compression, "fl32", 4) || !memcmp(compression, "FL32", 4)) { is_float = true; bits = 32; }
+                else if(!memcmp(compression, "fl64", 4) || !memcmp(compression, "FL64", 4)) { is_float = true; bits = 64; }
+                else if(memcmp(compression, "NONE", 4) && memcmp(compression, "twos", 4)) return false;
+            }
+            if(!mapped_soundfile_set_format(f, mapped_soundfile_u16(body, true), bits, is_float)) return false;
+            num_frames = mapped_soundfile_u32(body + 2, true);
+            f->samplerate = (float)mapped_soundfile_extended(body + 8);
+        }
+        else if(!memcmp(chunk, "SSND", 4) && size >= 8 && available >= 8)
+        {
+            size_t offset = mapped_soundfile_u32(body, true);
+            if(offset > size - 8 || offset > available - 8) return false;
+            data = body + 8 + offset;
+            data_size = size - 8 - offset;
+        }
+        position += 8 + size + (size & 1);
+    }
+    if(num_frames < 0 || !data) return false;
+
+    mapped_soundfile_set_frames(f, data, data_size, num_frames);
+    return true;
+}
+/**
+ * @brief maps a soundfile
+ * @details the file is mapped read only and only its header is read, the sample frames are brought in by the operating system when they are first read <br>
+ * @param f the file, closed if the file cannot be played <br>
+ * @param path path of the WAV or AIFF file <br>
+ * @return true if the file is mapped and has at least one sample frame <br>
+ */
+bool mapped_soundfile_open(mapped_soundfile *f, const char *path)
+{
+    struct stat st;
+    const unsigned char *p;
+    void *map;
+    bool ok = false;
+    int fd;
+
+    memset(f, 0, sizeof(mapped_soundfile));
+    if((fd = open(path, O_RDONLY)) < 0) return false;
+    if(fstat(fd, &st) != 0 || st.st_size < 12)
+    {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return false;
+
+    f->map = map;
+    f->map_size = st.st_size;
+    p = (const unsigned char *)map;
+    if(!memcmp(p, "RIFF", 4) && !memcmp(p + 8, "WAVE", 4)) ok = mapped_soundfile_parse_wav(f);
+    else if(!memcmp(p, "FORM", 4) && !memcmp(p + 8, "AIFF", 4)) ok = mapped_soundfile_parse_aiff(f, false);
+    else if(!memcmp(p, "FORM", 4) && !memcmp(p + 8, "AIFC", 4)) ok = mapped_soundfile_parse_aiff(f, true);
+
+    if(!ok || f->num_frames < 1)
+    {
+        mapped_soundfile_close(f);
+        return false;
+    }
+    return true;
+}
+/**
+ * @brief unmaps a soundfile
+ * @param f the file, may be closed already <br>
+ */
+void mapped_soundfile_close(mapped_soundfile *f)
+{
+    if(f->map) munmap(f->map, f->map_size);
+    memset(f, 0, sizeof(mapped_soundfile));
+}
+/**
+ * @brief drops the pages of some sample frames from memory
+ * @details the pages are read from the file again when they are touched the next time, only pages that lie entirely within the frames are dropped <br>
+ * @param f the file <br>
+ * @param frame first sample frame <br>
+ * @param num_frames number of sample frames <br>
+ */
+void mapped_soundfile_evict(const mapped_soundfile *f, int frame, int num_frames)
+{
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)(f->data + (size_t)frame * f->frame_size);
+    uintptr_t last = first + (size_t)num_frames * f->frame_size;
+
+    first = (first + page - 1) & ~(page - 1);
+    last &= ~(page - 1);
+    if(f->map && last > first) madvise((void *)first, last - first, MADV_DONTNEED);
+}
+/**
+ * @brief version of a file on disk
+ * @details changes whenever the file is written, built from its modification time and size <br>
+ * @param path path of the file <br>
+ * @return int64_t the version, -1 if the file does not exist <br>
+ */
+int64_t mapped_soundfile_version(const char *path)
+{
+    struct stat st;
+    if(stat(path, &st) != 0) return -1;
+    return ((int64_t)st.st_mtime << 24) ^ (int64_t)st.st_size;
+}
+/**
+ * @brief reads one sample
+ * @details integer samples are scaled to the range of -1 - 1 <br>
+ * @param f the file <br>
+ * @param frame index of the sample frame <br>
+ * @param channel channel of the sample <br>
+ * @return float the sample <br>
+ */
+float mapped_soundfile_sample(const mapped_soundfile *f, int frame, int channel)
+{
+    const unsigned char *p = f->data + (size_t)frame * f->frame_size + (size_t)channel * f->bytes_per_sample;
+    uint32_t bits;
+    uint64_t wide_bits;
+    float value;
+    double wide_value;
+
+    switch(f->format)
+    {
+        case MAPPED_INT16:
+            return (int16_t)mapped_soundfile_u16(p, f->big_endian) / 32768.0f;
+        case MAPPED_INT24:
+            bits = f->big_endian ? ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8)
+                                 : ((uint32_t)p[2] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 8);
+            return (int32_t)bits / 2147483648.0f;
+        case MAPPED_INT32:
+            return (int32_t)mapped_soundfile_u32(p, f->big_endian) / 2147483648.0f;
+        case MAPPED_FLOAT32:
+            bits = mapped_soundfile_u32(p, f->big_endian);
+            memcpy(&value, &bits, sizeof(float));
+            return value;
+        case MAPPED_FLOAT64:
+            wide_bits = mapped_soundfile_u64(p, f->big_endian);
+            memcpy(&wide_value, &wide_bits, sizeof(double));
+            return (float)wide_value;
+    }
+    return 0;
+}
+/**
+ * @brief the sample frames as floats
+ * @details single precision samples in the byte order of the CPU can be read in place, with a stride of @a num_channels floats <br>
+ * @param f the file <br>
+ * @return const float* first sample of the first channel, NULL if the samples have to be converted <br>
+ */
+const float *mapped_soundfile_floats(const mapped_soundfile *f)
+{
+    const uint16_t one = 1;
+    bool big_endian_cpu = (*(const unsigned char *)&one == 0);
+
+    if(f->format != MAPPED_FLOAT32 || f->big_endian != big_endian_cpu || ((uintptr_t)f->data % sizeof(float)) != 0) return NULL;
+    return (const float *)f->data;
+}
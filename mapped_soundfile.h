@@ -0,0 +1,65 @@
+/**
+ * @file mapped_soundfile.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a mapped_soundfile.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef mapped_soundfile_h
+#define mapped_soundfile_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief sample format of a mapped soundfile
+ */
+enum mapped_format {
+    MAPPED_INT16,                               ///< 16 bit signed integer <br>
+    MAPPED_INT24,                               ///< 24 bit signed integer, packed into 3 bytes <br>
+    MAPPED_INT32,                               ///< 32 bit signed integer <br>
+    MAPPED_FLOAT32,                             ///< IEEE single precision <br>
+    MAPPED_FLOAT64                              ///< IEEE double precision <br>
+};
+
+/**
+ * @struct mapped_soundfile
+ * @brief a WAV or AIFF file mapped into memory
+ * @details the sample frames are read straight from the mapping, the operating system brings in the pages when they are first touched <br>
+ */
+typedef struct mapped_soundfile
+{
+    void        *map;                           ///< start of the mapping, NULL if no file is mapped <br>
+    size_t      map_size;                       ///< size of the mapping in bytes <br>
+    const unsigned char *data;                  ///< first sample frame <br>
+    enum mapped_format format;                  ///< sample format <br>
+    bool        big_endian;                     ///< byte order of the samples <br>
+    int         num_channels,                   ///< number of interleaved channels <br>
+                num_frames,                     ///< number of sample frames <br>
+                bytes_per_sample,               ///< size of one sample of one channel <br>
+                frame_size;                     ///< size of one sample frame in bytes <br>
+    float       samplerate;                     ///< samplerate stored in the file <br>
+} mapped_soundfile;
+
+bool mapped_soundfile_open(mapped_soundfile *f, const char *path);
+void mapped_soundfile_close(mapped_soundfile *f);
+void mapped_soundfile_evict(const mapped_soundfile *f, int frame, int num_frames);
+int64_t mapped_soundfile_version(const char *path);
+float mapped_soundfile_sample(const mapped_soundfile *f, int frame, int channel);
+const float *mapped_soundfile_floats(const mapped_soundfile *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,351 @@
+/**
+ * @file mipmap.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief band limited pyramid of the soundfile
+ * @details grains that read the soundfile faster than the original speed read a half-band filtered and decimated copy instead, so high transpositions do not alias and touch less memory.
+ * The pyramid is built once when the soundfile is loaded and can then be stored in 16 bits, rounded once per sample <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <math.h>
+#include "mipmap.h"
+
+/**
+ * @brief number of samples of a level
+ * @details one more than the sample index of the wrap position plus the sample behind it, which linear interpolation reads at the wrap position <br>
+ * @param wrap wrap position of the level <br>
+ * @return int number of samples <br>
+ */
+static int mipmap_level_length(fixed_position wrap)
+{
+    return fixed_index(wrap) + 2;
+}
+/**
+ * @brief arena memory of a table with guard samples
+ * @param length number of samples without the guard samples <br>
+ * @return size_t size in bytes <br>
+ */
+size_t mipmap_table_size(int length)
+{
+    return purple_arena_aligned_size((length + 2 * MIPMAP_GUARD) * sizeof(float));
+}
+/**
+ * @brief allocates a table with guard samples
+ * @param arena arena the table is allocated from <br>
+ * @param length number of samples without the guard samples <br>
+ * @return float* first sample behind the front guard, NULL if the arena is exhausted <br>
+ */
+float *mipmap_table_alloc(purple_arena *arena, int length)
+{
+    float *table = (float *) purple_arena_alloc(arena, (length + 2 * MIPMAP_GUARD) * sizeof(float));
+    return table ? table + MIPMAP_GUARD : NULL;
+}
+/**
+ * @brief sample a guard sample holds
+ * @param index index of the guard sample, outside of the table <br>
+ * @param wrap_index index the loop of the table wraps around at <br>
+ * @return int index of the sample inside of the table <br>
+ */
+static int mipmap_guard_source(int index, int wrap_index)
+{
+    while(index < 0) index += wrap_index;
+    while(index > wrap_index) index -= wrap_index;
+    return index;
+}
+/**
+ * @brief fills the guard samples of a table
+ * @details the guards continue the loop of the table, sample n outside of the table holds the sample n is wrapped to <br>
+ * @param table first sample of the table <br>
+ * @param length number of samples of the table <br>
+ * @param wrap_index index the loop of the table wraps around at <br>
+ */
+static void mipmap_fill_guards(float *table, int length, int wrap_index)
+{
+    for(int j = 1; j <= MIPMAP_GUARD; j++)
+    {
+        table[-j] = table[mipmap_guard_source(-j, wrap_index)];
+    }
+    for(int j = 0; j < MIPMAP_GUARD; j++)
+    {
+        table[length + j] = table[mipmap_guard_source(length + j, wrap_index)];
+    }
+}
+/**
+ * @brief fills the guard samples of a 16 bit table
+ * @details copies the stored samples, so a guard widens to exactly the sample it continues <br>
+ * @param table first sample of the table <br>
+ * @param length number of samples of the table <br>
+ * @param wrap_index index the loop of the table wraps around at <br>
+ */
+static void mipmap_fill_compact_guards(uint16_t *table, int length, int wrap_index)
+{
+    for(int j = 1; j <= MIPMAP_GUARD; j++)
+    {
+        table[-j] = table[mipmap_guard_source(-j, wrap_index)];
+    }
+    for(int j = 0; j < MIPMAP_GUARD; j++)
+    {
+        table[length + j] = table[mipmap_guard_source(length + j, wrap_index)];
+    }
+}
+/**
+ * @brief number of levels built for a soundfile
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @return int number of levels including the soundfile itself <br>
+ */
+static int mipmap_num_levels(int soundfile_length)
+{
+    int num_levels = 1;
+    float wrap_length = soundfile_length - 1;
+    while(num_levels < MIPMAP_LEVELS && wrap_length / 2 >= MIPMAP_MIN_LENGTH)
+    {
+        wrap_length /= 2;
+        num_levels++;
+    }
+    return num_levels;
+}
+/**
+ * @brief arena memory needed by the levels above the soundfile
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param reversed whether the backwards copy of the soundfile is built <br>
+ * @return size_t size in bytes <br>
+ */
+size_t mipmap_arena_size(int soundfile_length, bool reversed)
+{
+    size_t size = reversed ? mipmap_table_size(soundfile_length) : 0;
+    fixed_position wrap = (fixed_position)(soundfile_length - 1) << FIXED_FRACTION_BITS;
+    for(int l = 1; l < mipmap_num_levels(soundfile_length); l++)
+    {
+        size += mipmap_table_size(mipmap_level_length(wrap >> l));
+    }
+    return size;
+}
+/**
+ * @brief builds the pyramid of a soundfile
+ * @details every level is filtered by a blackman windowed half-band filter and decimated by 2, the filter reads the guard samples of the previous level where it reaches around the loop.
+ * Fills the guard samples of @a soundfile_table as well <br>
+ * @param m pointer to the mipmap <br>
+ * @param arena arena the levels are allocated from <br>
+ * @param soundfile_table level 0, allocated by @a mipmap_table_alloc <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param reversed whether the backwards copy of the soundfile is built, backwards grains read it forwards <br>
+ * @return true on success, false if the arena is exhausted <br>
+ */
+bool mipmap_build(mipmap *m, purple_arena *arena, float *soundfile_table, int soundfile_length, bool reversed)
+{
+    float halfband[HALFBAND_TAPS];
+    const int center = HALFBAND_TAPS / 2;
+    double sum = 0;
+    
+    for(int j = 0; j < HALFBAND_TAPS; j++)
+    {
+        int x = j - center;
+        double sinc = (x == 0) ? 0.5 : (x % 2 == 0) ? 0.0 : sin(M_PI * x / 2) / (M_PI * x);
+        double window = 0.42 + 0.5 * cos(M_PI * x / (center + 1)) + 0.08 * cos(2 * M_PI * x / (center + 1));
+        halfband[j] = (float)(sinc * window);
+        sum += halfband[j];
+    }
+    for(int j = 0; j < HALFBAND_TAPS; j++)
+    {
+        halfband[j] = (float)(halfband[j] / sum);
+    }
+    
+    m->num_levels = mipmap_num_levels(soundfile_length);
+    m->format = SAMPLE_FLOAT32;
+    m->compact_reversed = NULL;
+    m->levels[0] = soundfile_table;
+    m->wraps[0] = (fixed_position)(soundfile_length - 1) << FIXED_FRACTION_BITS;
+    m->reversed = NULL;
+    if(soundfile_length < 2) return true;
+    mipmap_fill_guards(soundfile_table, soundfile_length, soundfile_length - 1);
+    
+    if(reversed)
+    {
+        if(!(m->reversed = mipmap_table_alloc(arena, soundfile_length))) return false;
+        for(int n = 0; n < soundfile_length; n++)
+        {
+            m->reversed[n] = soundfile_table[soundfile_length - 1 - n];
+        }
+        mipmap_fill_guards(m->reversed, soundfile_length, soundfile_length - 1);
+    }
+    
+    for(int l = 1; l < m->num_levels; l++)
+    {
+        const float *source = m->levels[l - 1];
+        
+        m->wraps[l] = m->wraps[0] >> l;
+        int length = mipmap_level_length(m->wraps[l]);
+        float *level = mipmap_table_alloc(arena, length);
+        
+        if(!level) return false;
+        for(int n = 0; n < length; n++)
+        {
+            float value = 0;
+            for(int j = 0; j < HALFBAND_TAPS; j++)
+            {
+                if(halfband[j] != 0) value += source[2 * n + j - center] * halfband[j];
+            }
+            level[n] = value;
+        }
+        mipmap_fill_guards(level, length, fixed_index(m->wraps[l]));
+        m->levels[l] = level;
+    }
+    return true;
+}
+/**
+ * @brief uses a soundfile that is read in place as the only level
+ * @details builds neither band limited levels nor the reversed copy, so nothing is allocated. The soundfile has no guard samples <br>
+ * @param m pointer to the mipmap <br>
+ * @param samples first sample of the soundfile <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ */
+void mipmap_view(mipmap *m, float *samples, int soundfile_length)
+{
+    m->num_levels = 1;
+    m->format = SAMPLE_FLOAT32;
+    m->compact_reversed = NULL;
+    m->levels[0] = samples;
+    m->wraps[0] = (fixed_position)(soundfile_length - 1) << FIXED_FRACTION_BITS;
+    m->reversed = NULL;
+}
+/**
+ * @brief picks the level for a playback rate
+ * @details the level whose rate lies closest to the original speed, rounded in octaves, so a level is read at 0.71 - 1.41 times its own speed <br>
+ * @param m pointer to the mipmap <br>
+ * @param rate absolute read step per output sample <br>
+ * @return int level <br>
+ */
+int mipmap_level(mipmap *m, float rate)
+{
+    if(rate < 1.41421356f) return 0;
+    int level = (int)(log2f(rate) + 0.5f);
+    return (level < m->num_levels) ? level : m->num_levels - 1;
+}
+/**
+ * @brief converts a sample to 16 bits
+ * @details int16 samples are rounded with triangular dither of 1 LSB that depends only on @a level and @a n, so the same sample always converts to the same value. Samples that already are 16 bit values, like those of 16 bit files, are kept exactly.
+ * Half floats are rounded to the nearest even value and clipped to the largest finite half <br>
+ * @param value the sample <br>
+ * @param level level of the pyramid the sample belongs to <br>
+ * @param n index of the sample in its level <br>
+ * @param format @a SAMPLE_INT16 or @a SAMPLE_HALF <br>
+ * @return uint16_t bits of the converted sample <br>
+ */
+uint16_t mipmap_narrow(float value, int level, int n, enum sample_format format)
+{
+    union { uint32_t bits; float value; } source;
+    uint32_t sign, bits;
+
+    if(format == SAMPLE_INT16)
+    {
+        float scaled = value * 32768;
+        if(scaled != floorf(scaled))
+        {
+            uint32_t hash = (uint32_t)n * 0x9e3779b1u + (uint32_t)level * 0x85ebca77u;
+            hash ^= hash >> 15;
+            hash *= 0x2c1b3c6du;
+            hash ^= hash >> 12;
+            scaled += ((float)(hash & 0xffff) - (float)(hash >> 16)) / 65536;
+        }
+        long rounded = lrintf(scaled);
+        if(rounded > 32767) rounded = 32767;
+        if(rounded < -32768) rounded = -32768;
+        return (uint16_t)(int16_t)rounded;
+    }
+
+    source.value = value;
+    sign = (source.bits >> 16) & 0x8000;
+    bits = source.bits & 0x7fffffff;
+    if(bits > 0x477fe000) return (uint16_t)(sign | 0x7bff);
+    if(bits < 0x38800000)
+    {
+        source.bits = bits;
+        return (uint16_t)(sign | (uint32_t)lrintf(source.value * 0x1p24f));
+    }
+    bits += 0x0fff + ((bits >> 13) & 1);
+    return (uint16_t)(sign | ((bits >> 13) - (112 << 10)));
+}
+/**
+ * @brief arena memory of the pyramid stored in 16 bits
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param reversed whether the backwards copy of the soundfile is built <br>
+ * @return size_t size in bytes <br>
+ */
+size_t mipmap_compact_arena_size(int soundfile_length, bool reversed)
+{
+    size_t size = purple_arena_aligned_size((soundfile_length + 2 * MIPMAP_GUARD) * sizeof(uint16_t)) * (reversed ? 2 : 1);
+    fixed_position wrap = (fixed_position)(soundfile_length - 1) << FIXED_FRACTION_BITS;
+    for(int l = 1; l < mipmap_num_levels(soundfile_length); l++)
+    {
+        size += purple_arena_aligned_size((mipmap_level_length(wrap >> l) + 2 * MIPMAP_GUARD) * sizeof(uint16_t));
+    }
+    return size;
+}
+/**
+ * @brief allocates a 16 bit table with guard samples
+ * @param arena arena the table is allocated from <br>
+ * @param length number of samples without the guard samples <br>
+ * @return uint16_t* first sample behind the front guard, NULL if the arena is exhausted <br>
+ */
+static uint16_t *mipmap_compact_table_alloc(purple_arena *arena, int length)
+{
+    uint16_t *table = (uint16_t *) purple_arena_alloc(arena, (length + 2 * MIPMAP_GUARD) * sizeof(uint16_t));
+    return table ? table + MIPMAP_GUARD : NULL;
+}
+/**
+ * @brief stores a built pyramid in 16 bits
+ * @details converts every level and the reversed copy once, the kernels widen the samples again while they read them. The float levels are no longer used afterwards, the caller frees them.
+ * Pyramids of soundfiles shorter than 2 samples stay float <br>
+ * @param m pointer to the mipmap, built by @a mipmap_build <br>
+ * @param arena arena of at least @a mipmap_compact_arena_size bytes the 16 bit levels are allocated from <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param format @a SAMPLE_INT16 or @a SAMPLE_HALF <br>
+ * @return true if the pyramid is stored in @a format, false if it stays float because the arena is exhausted or nothing is converted <br>
+ */
+bool mipmap_compact(mipmap *m, purple_arena *arena, int soundfile_length, enum sample_format format)
+{
+    uint16_t *levels[MIPMAP_LEVELS], *reversed = NULL;
+
+    if(format == SAMPLE_FLOAT32 || soundfile_length < 2) return false;
+
+    for(int l = 0; l < m->num_levels; l++)
+    {
+        int length = (l == 0) ? soundfile_length : mipmap_level_length(m->wraps[l]);
+        if(!(levels[l] = mipmap_compact_table_alloc(arena, length))) return false;
+    }
+    if(m->reversed && !(reversed = mipmap_compact_table_alloc(arena, soundfile_length))) return false;
+
+    for(int l = 0; l < m->num_levels; l++)
+    {
+        int length = (l == 0) ? soundfile_length : mipmap_level_length(m->wraps[l]);
+        uint16_t *level = levels[l];
+        
+        for(int n = 0; n < length; n++)
+        {
+            level[n] = mipmap_narrow(m->levels[l][n], l, n, format);
+        }
+        mipmap_fill_compact_guards(level, length, fixed_index(m->wraps[l]));
+        m->compact_levels[l] = level;
+        m->levels[l] = NULL;
+    }
+    if(m->reversed)
+    {
+        m->compact_reversed = reversed;
+        for(int n = 0; n < soundfile_length; n++)
+        {
+            m->compact_reversed[n] = m->compact_levels[0][soundfile_length - 1 - n];
+        }
+        mipmap_fill_compact_guards(m->compact_reversed, soundfile_length, soundfile_length - 1);
+        m->reversed = NULL;
+    }
+    m->format = format;
+    return true;
+}
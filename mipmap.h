@@ -0,0 +1,60 @@
+/**
+ * @file mipmap.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a mipmap.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef mipmap_h
+#define mipmap_h
+
+#include "purple_utils.h"
+#include "grain_kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIPMAP_LEVELS 8                         ///< maximum number of levels including the soundfile itself, the last level is read at up to 2^7.5 times the original speed <br>
+#define MIPMAP_MIN_LENGTH 64                    ///< shortest level that is still built <br>
+#define HALFBAND_TAPS 31                        ///< length of the half-band filter applied before decimation <br>
+#define MIPMAP_GUARD 32                         ///< samples in front of and behind every level, two cache lines, holds the wrapped samples the interpolators and the half-band filter read outside of the level <br>
+
+/**
+ * @struct mipmap
+ * @brief band limited copies of the soundfile
+ * @details level 0 is the soundfile table, every further level is the previous one half-band filtered and decimated by 2.
+ * Sample n of level l lies at position n * 2^l of the soundfile.
+ * Every level is stored with @a MIPMAP_GUARD samples on both sides that continue the loop of the level, so reads a few samples outside of the level need no wrapping. The first sample of every level is 64-byte aligned <br>
+ */
+typedef struct mipmap
+{
+    int         num_levels;                     ///< number of built levels <br>
+    float       *levels[MIPMAP_LEVELS];         ///< samples of every level <br>
+    fixed_position wraps[MIPMAP_LEVELS];        ///< (soundfile length - 1) / 2^l as fixed point, read positions of a level wrap around at this value <br>
+    float       *reversed;                      ///< level 0 backwards, sample n holds sample soundfile length - 1 - n, NULL if not built <br>
+    enum sample_format format;                  ///< format the levels are stored in, @a levels and @a reversed are NULL unless it is @a SAMPLE_FLOAT32 <br>
+    uint16_t    *compact_levels[MIPMAP_LEVELS]; ///< samples of every level in 16 bits, with the same guard samples as @a levels <br>
+    uint16_t    *compact_reversed;              ///< @a reversed in 16 bits, NULL if not built <br>
+} mipmap;
+
+size_t mipmap_table_size(int length);
+float *mipmap_table_alloc(purple_arena *arena, int length);
+size_t mipmap_arena_size(int soundfile_length, bool reversed);
+bool mipmap_build(mipmap *m, purple_arena *arena, float *soundfile_table, int soundfile_length, bool reversed);
+void mipmap_view(mipmap *m, float *samples, int soundfile_length);
+int mipmap_level(mipmap *m, float rate);
+uint16_t mipmap_narrow(float value, int level, int n, enum sample_format format);
+size_t mipmap_compact_arena_size(int soundfile_length, bool reversed);
+bool mipmap_compact(mipmap *m, purple_arena *arena, int soundfile_length, enum sample_format format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
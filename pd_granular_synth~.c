@@ -10,11 +10,17 @@
  */
 
 
+#include <string.h>
 #include "c_granular_synth.h"
 #include "purple_utils.h"
+#include "sample_loader.h"
 
 static t_class *pd_granular_synth_tilde_class;
 
+#define EVENT_QUEUE_SIZE 64                             ///< maximum number of notes and parameter changes received within one dsp block <br>
+#define LOAD_POLL_MS 5                                  ///< interval in which pd checks whether the loader is done <br>
+#define PERFORM_NUM_ARGS (4 + NUM_MODULATIONS)          ///< arguments of the perform routine: object, main inlet, modulation inlets, outlet and block size <br>
+
 /**
  * @struct c_granular_synth_tilde_
  * @brief pure data struct of the @a c_granular_synth_tilde object
@@ -32,16 +38,40 @@ typedef struct pd_granular_synth_tilde
                         attack,                         ///< attack time in the range of 0 - 4000ms, adjustable through slider <br>
                         decay,                          ///< decay time in the range of 0 - 4000ms, adjustable through slider <br>
                         release,                        ///< release time in the range of 0 - 10000ms, adjustable through slider <br>
-                        spray_input;                    ///< randomizes the start position of each grain in the range of 0 - 75, adjustable through slider <br>
+                        spray_input,                    ///< randomizes the start position of each grain in the range of 0 - 75, adjustable through slider <br>
+                        num_voices;                     ///< number of voices for polyphonic playback <br>
+    synth_event         events[EVENT_QUEUE_SIZE];       ///< notes and parameter changes received since the last dsp block, sorted by offset <br>
+    int                 num_events,                     ///< number of events in @a events <br>
+                        block_size;                     ///< size of the last dsp block <br>
+    double              block_time;                     ///< logical time of the last dsp block, events are placed in the next block relative to it <br>
+    bool                velo_pending;                   ///< a velocity arrived that is not yet part of a queued note <br>
+    int                 velo_offset;                    ///< sample of the next block at which the pending velocity arrived <br>
     t_float             sustain,                        ///< sustain time in the range of 0 - 1, adjustable through slider <br>
                         time_stretch_factor,            ///< resizes sample length within a grain, for negative values read samples in backwards direction, adjustable through slider <br>
                         gauss_q_factor;                 ///< used to manipulate grain envelope slope in the range of 0.01 - 1, adjustable through slider <br>
     t_word              *soundfile;                     ///< Pointer to the soundfile Array <br>
+    int                 array_length;                   ///< length of @a soundfile in samples, the synth plays @a soundfile_length samples until the array is loaded <br>
     t_symbol            *soundfile_arrayname;           ///< String used in pd to identify array that holds the soundfile <br>
+    t_symbol            *soundfile_path;                ///< path of the file opened by the @a open message, NULL while the array is played <br>
+    int                 soundfile_channel,              ///< channel of @a soundfile_path that is played <br>
+                        cache_size;                     ///< size of the block cache of a streamed file in megabytes, selectable through the @a cache message <br>
+    t_canvas            *canvas;                        ///< canvas the object was created on, relative paths start at its directory <br>
+    sample_loader       loader;                         ///< makes the sample buffers in the background <br>
+    t_clock             *load_clock;                    ///< polls @a loader and reports loaded buffers <br>
+    t_symbol            *loading_path;                  ///< file of the latest request to @a loader, NULL for the array <br>
+    int                 loading_channel;                ///< channel of @a loading_path <br>
+    bool                ready_pending;                  ///< a new buffer plays and was not reported on @a out_ready yet <br>
     int                 grain_size,                     ///< size of a grain in milliseconds, adjustable through slider <br>          
                         soundfile_length;               ///< lenght of the soundfile in samples <b>
     float               pitch_factor,                   ///< scaled by pitch/key value given by MIDI input <br>
-                        soundfile_length_ms;            ///< lenght of the soundfile in milliseconds <b>
+                        soundfile_length_ms,            ///< lenght of the soundfile in milliseconds <b>
+                        grain_density;                  ///< grains per second started by the density based scheduler <br>
+    enum grain_scheduler scheduler;                     ///< grain scheduler, selectable through the @a scheduler message <br>
+    enum window_shape   window_shape;                   ///< grain window, selectable through the @a window message <br>
+    enum interpolation  interpolation;                  ///< interpolation between the samples of the soundfile, selectable through the @a interpolation message <br>
+    enum soundfile_storage storage;                     ///< whether the synth copies the array or reads it in place, selectable through the @a storage message <br>
+    enum sample_format  precision;                      ///< format a copied soundfile is stored in, selectable through the @a precision message <br>
+    int                 ramp_time[NUM_RAMPS];           ///< glide times of start position, grain size and time stretch factor in milliseconds, set by the @a ramp message <br>
 
     t_inlet             *in_midi_pitch,                 ///< inlet for MIDI input pitch/key value <br>
                         *in_midi_velo,                  ///< inlet for MIDI input velocity value <br>
@@ -53,10 +83,90 @@ typedef struct pd_granular_synth_tilde
                         *in_attack,                     ///< inlet attack slider <br>
                         *in_decay,                      ///< inlet for decay slider <br>
                         *in_sustain,                    ///< inlet for sustain slider <br>
-                        *in_release;                    ///< inlet for release slider <br>;
-    t_outlet            *out;                           ///< main outlet <br>
+                        *in_release,                    ///< inlet for release slider <br>;
+                        *in_modulation[NUM_MODULATIONS];///< signal inlets added to start position, time stretch factor, grain size, spray and density <br>
+    t_sample            *modulation;                    ///< copies of the modulation signals of the current block, the output may share their memory <br>
+    int                 modulation_size;                ///< number of samples @a modulation holds per signal <br>
+    t_outlet            *out,                           ///< main outlet <br>
+                        *out_ready;                     ///< outputs the length of the soundfile in samples whenever a new one plays <br>
 } t_pd_granular_synth_tilde;
 
+static void pd_granular_synth_tilde_poll(t_pd_granular_synth_tilde *x);
+
+/**
+ * @related pd_granular_synth_tilde
+ * @brief sample of the next dsp block at which a message received now is placed
+ * @details the sample lies as far behind the start of the next block as the message lies behind the start of the last block, so messages sent by clocks keep their timing at one block of latency, like vline~ does <br>
+ * @param x input pointer of @a pd_granular_synth_tilde object <br>
+ * @return offset of the event in the next block <br>
+ */
+static int pd_granular_synth_event_offset(t_pd_granular_synth_tilde *x)
+{
+    int offset = (int)(clock_gettimesince(x->block_time) * x->sr / 1000.0);
+    if(offset < 0) offset = 0;
+    if(offset >= x->block_size) offset = x->block_size - 1;
+    return offset;
+}
+/**
+ * @related pd_granular_synth_tilde
+ * @brief queues a note or parameter change at a sample of the next dsp block
+ * @details when the queue is full, as it gets while dsp is off, the queued events are applied to the synth right away, so no note or change is lost and the synth keeps the values of the object <br>
+ * @param x input pointer of @a pd_granular_synth_tilde object <br>
+ * @param offset sample of the next block the event is placed at <br>
+ * @param type what the event changes <br>
+ * @param value new value of the parameter, pitch/key of a note <br>
+ * @param velocity velocity of a note <br>
+ */
+static void pd_granular_synth_queue_event_at(t_pd_granular_synth_tilde *x, int offset, enum synth_event_type type, float value, float velocity)
+{
+    int i;
+    
+    if(x->num_events >= EVENT_QUEUE_SIZE)
+    {
+        for(i = 0; x->synth && i < x->num_events; i++)
+        {
+            c_granular_synth_apply_event(x->synth, &x->events[i]);
+        }
+        x->num_events = 0;                              ///< without a synth the values are taken when it is made
+    }
+    
+    for(i = x->num_events; i > 0 && x->events[i - 1].offset > offset; i--)
+    {
+        x->events[i] = x->events[i - 1];
+    }
+    x->events[i].offset = offset;
+    x->events[i].type = type;
+    x->events[i].value = value;
+    x->events[i].velocity = velocity;
+    x->num_events++;
+}
+/**
+ * @related pd_granular_synth_tilde
+ * @brief queues a note or parameter change received now for the next dsp block
+ * @param x input pointer of @a pd_granular_synth_tilde object <br>
+ * @param type what the event changes <br>
+ * @param value new value of the parameter, pitch/key of a note <br>
+ * @param velocity velocity of a note <br>
+ */
+static void pd_granular_synth_queue_event(t_pd_granular_synth_tilde *x, enum synth_event_type type, float value, float velocity)
+{
+    pd_granular_synth_queue_event_at(x, pd_granular_synth_event_offset(x), type, value, velocity);
+}
+/**
+ * @related pd_granular_synth_tilde
+ * @brief queues a note for the next dsp block
+ * @details several note-ons and note-offs within one block reach different voices at their own samples <br>
+ * @param x input pointer of @a pd_granular_synth_tilde object <br>
+ * @param offset sample of the next block the note starts or ends at <br>
+ * @param midi_pitch MIDI pitch/key value <br>
+ * @param midi_velo MIDI velocity value, 0 for note-off <br>
+ */
+static void pd_granular_synth_queue_note(t_pd_granular_synth_tilde *x, int offset, t_int midi_pitch, t_int midi_velo)
+{
+    x->velo_pending = false;
+    pd_granular_synth_queue_event_at(x, offset, EVENT_NOTE, midi_pitch, midi_velo);
+}
+
 /** 
  * @related pd_granular_synth_tilde
  * @brief Creates a new pd_granular_synth_tilde object.<br>
@@ -70,6 +180,16 @@ void *pd_granular_synth_tilde_new(t_symbol *soundfile_arrayname)
     x->sr  = sys_getsr();
     x->soundfile = 0;
     x->soundfile_arrayname = soundfile_arrayname;
+    x->soundfile_path = NULL;
+    x->soundfile_channel = 0;
+    x->cache_size = STREAM_DEFAULT_CACHE_MB;
+    x->canvas = canvas_getcurrent();
+    x->array_length = 0;
+    x->loading_path = NULL;
+    x->loading_channel = 0;
+    x->ready_pending = false;
+    x->load_clock = clock_new(x, (t_method)pd_granular_synth_tilde_poll);
+    sample_loader_start(&x->loader);
 
     x->soundfile_length = 0;                            ///< default value for soundfile length in samples <b>
     x->soundfile_length_ms = 0;                         ///< default value for soundfile length in ms <b>
@@ -85,6 +205,22 @@ void *pd_granular_synth_tilde_new(t_symbol *soundfile_arrayname)
     x->release = 1000;                                  ///< default value for release time, before adjustment through slider <b>
     x->gauss_q_factor = 0.2;                            ///< default value for gauss q factor, before adjustment through slider <b>
     x->spray_input = 0;                                 ///< default value for spray randomizer, before adjustment through slider <b>
+    x->scheduler = SCHEDULE_TABLE;                      ///< default grain scheduler, grain table laid out over the soundfile <b>
+    x->grain_density = 20;                              ///< default value for grains per second of the density based scheduler <b>
+    x->num_voices = 8;                                  ///< default value for the number of voices <b>
+    x->window_shape = WINDOW_GAUSS;                     ///< default value for the grain window <b>
+    x->interpolation = INTERPOLATE_LINEAR;              ///< default value for the interpolation <b>
+    x->storage = STORAGE_COPY;                          ///< default storage, the array is copied <b>
+    x->precision = SAMPLE_FLOAT32;                      ///< default precision, the copy is stored as float <b>
+    for(int r = 0; r < NUM_RAMPS; r++)
+    {
+        x->ramp_time[r] = 0;                            ///< default glide time, parameters change right away <b>
+    }
+    x->num_events = 0;
+    x->block_size = 64;
+    x->block_time = clock_getlogicaltime();
+    x->velo_pending = false;
+    x->velo_offset = 0;
     
     /// @note The main inlet is created automatically
     x->in_midi_pitch = inlet_new(&x->x_obj,  &x->x_obj.ob_pd, &s_float, gensym("midi_pitch"));
@@ -98,8 +234,15 @@ void *pd_granular_synth_tilde_new(t_symbol *soundfile_arrayname)
     x->in_decay = inlet_new(&x->x_obj,  &x->x_obj.ob_pd, &s_float, gensym("decay"));
     x->in_sustain = inlet_new(&x->x_obj,  &x->x_obj.ob_pd, &s_float, gensym("sustain"));
     x->in_release = inlet_new(&x->x_obj,  &x->x_obj.ob_pd, &s_float, gensym("release"));
+    for(int m = 0; m < NUM_MODULATIONS; m++)
+    {
+        x->in_modulation[m] = inlet_new(&x->x_obj,  &x->x_obj.ob_pd, &s_signal, &s_signal);
+    }
+    x->modulation = NULL;
+    x->modulation_size = 0;
     
     x->out = outlet_new(&x->x_obj, &s_signal);
+    x->out_ready = outlet_new(&x->x_obj, &s_float);
     return (void *)x;
 }
 
@@ -114,19 +257,29 @@ t_int *pd_granular_synth_tilde_perform(t_int *w)
 {
     t_pd_granular_synth_tilde *x = (t_pd_granular_synth_tilde *)(w[1]);
     t_sample  *in = (t_sample *)(w[2]);
-    t_sample  *out =  (t_sample *)(w[3]);
-    int n =  (int)(w[4]);
+    t_sample  *out =  (t_sample *)(w[PERFORM_NUM_ARGS - 1]);
+    int n =  (int)(w[PERFORM_NUM_ARGS]);
 
-    if(x->grain_size < 1) x->grain_size = 1;
-    if(x->grain_size >  (int)x->soundfile_length) x->grain_size = x->soundfile_length;
-    if(x->start_pos < 0) x->start_pos = 0;
-    if(x->start_pos > (int)x->soundfile_length) x->start_pos = x->soundfile_length - 1;
-
-    c_granular_synth_properties_update(x->synth, x->grain_size, x->start_pos, x->time_stretch_factor, x->midi_velo, x->midi_pitch, x->attack, x->decay, x->sustain, x->release, x->gauss_q_factor, x->spray_input); ///< passes all (slider) changes to synth
+    if(x->velo_pending) pd_granular_synth_queue_note(x, x->velo_offset, x->midi_pitch, x->midi_velo);
+    x->block_time = clock_getlogicaltime();
+    x->block_size = n;
+    
+    if(!x->synth)
+    {
+        x->num_events = 0;                              ///< the synth is made with the current values
+        while(n--) *out++ = 0;
+        return (w + PERFORM_NUM_ARGS + 1);
+    }
 
-    c_granular_synth_process(x->synth, in, out, n); ///< returns pointer to dataspace for the next dsp-object
+    for(int m = 0; m < NUM_MODULATIONS; m++)
+    {
+        memcpy(x->modulation + m * n, (t_sample *)(w[3 + m]), n * sizeof(t_sample));
+        c_granular_synth_set_modulation(x->synth, m, x->modulation + m * n);
+    }
+    c_granular_synth_process_events(x->synth, in, out, n, x->events, x->num_events); ///< applies every note and (slider) change of the last block at its sample
+    x->num_events = 0;
 
-    return (w+5); ///< returns argument equal to argument of the perform-routine plus the number of pointer variables +1
+    return (w + PERFORM_NUM_ARGS + 1); ///< returns argument equal to argument of the perform-routine plus the number of pointer variables +1
 }
 
 /**
@@ -150,15 +303,187 @@ void pd_granular_synth_tilde_free(t_pd_granular_synth_tilde *x)
         inlet_free(x->in_decay);
         inlet_free(x->in_sustain);
         inlet_free(x->in_release);
+        for(int m = 0; m < NUM_MODULATIONS; m++)
+        {
+            inlet_free(x->in_modulation[m]);
+        }
+        free(x->modulation);
         outlet_free(x->out);
+        outlet_free(x->out_ready);
+        clock_free(x->load_clock);
+        sample_loader_stop(&x->loader);
         c_granular_synth_free(x->synth);
         free(x);
     }
 }
 
+/**
+ * @brief hands a sample buffer to the synth
+ * @details the synth is made with the first buffer and only swaps its buffer afterwards, so restarting dsp keeps the playing grains.
+ * A new buffer is reported on the right outlet from the clock, never from within the dsp method <br>
+ * @param x granular synth object <br>
+ * @param b buffer acquired from the sample buffer cache, NULL if it could not be made <br>
+ */
+static void pd_granular_synth_tilde_bind(t_pd_granular_synth_tilde *x, sample_buffer *b)
+{
+    if(!b) return;
+    if(!x->synth || x->synth->buffer != b)
+    {
+        x->ready_pending = true;
+        clock_delay(x->load_clock, 0);
+    }
+    x->soundfile_length = b->length;
+    x->soundfile_length_ms = get_ms_from_samples(x->soundfile_length, x->sr);
+    if(x->soundfile_length && x->start_pos >= x->soundfile_length)
+    {
+        x->start_pos = x->soundfile_length - 1;
+        pd_granular_synth_queue_event(x, EVENT_START_POS, x->start_pos, 0);
+    }
+    if(x->synth)
+    {
+        c_granular_synth_set_buffer(x->synth, b); ///< keeps the synth of the previous dsp chain
+    }
+    else
+    {
+        x->synth = c_granular_synth_new(b, x->grain_size, x->start_pos, x->time_stretch_factor, x->attack, x->decay, x->sustain, x->release, x->gauss_q_factor, x->spray_input, x->pitch_factor, x->midi_pitch, x->scheduler, x->grain_density, x->num_voices, x->window_shape, x->interpolation);
+        if(!x->synth)
+        {
+            pd_error(x, "pd_granular_synth~: not enough memory for the synth");
+            x->ready_pending = false;
+            return;
+        }
+        for(int r = 0; r < NUM_RAMPS; r++)
+        {
+            c_granular_synth_set_ramp_time(x->synth, r, x->ramp_time[r]);
+        }
+    }
+}
+
+/**
+ * @brief hands a request to the loader
+ * @details the synth keeps playing its buffer, or stays silent, until @a pd_granular_synth_tilde_poll binds the new one <br>
+ * @param x granular synth object <br>
+ * @param r the request <br>
+ */
+static void pd_granular_synth_tilde_request(t_pd_granular_synth_tilde *x, const sample_load_request *r)
+{
+    sample_loader_request(&x->loader, r);
+    clock_delay(x->load_clock, LOAD_POLL_MS);
+}
+
+/**
+ * @brief loads the array
+ * @details a cached buffer of the array or a buffer that reads it in place is bound right away.
+ * Otherwise pd takes the samples of the array, which it may change or resize later, and the loader copies, converts and builds them into a buffer in the background <br>
+ * @param x granular synth object <br>
+ */
+static void pd_granular_synth_tilde_load_array(t_pd_granular_synth_tilde *x)
+{
+    sample_load_request r;
+    sample_buffer *b = sample_buffer_acquire_cached(x->soundfile_arrayname, x->soundfile, x->array_length, x->storage, x->precision);
+
+    x->loading_path = NULL;
+    if(b)
+    {
+        sample_loader_cancel(&x->loader);
+        pd_granular_synth_tilde_bind(x, b);
+        return;
+    }
+    if(x->array_length < 1) return;
+    if(!(r.samples = (float *)malloc(x->array_length * sizeof(float))))
+    {
+        pd_error(x, "pd_granular_synth~: not enough memory to load '%s'", x->soundfile_arrayname->s_name);
+        return;
+    }
+    for(int i = 0; i < x->array_length; i++)
+    {
+        r.samples[i] = x->soundfile[i].w_float;
+    }
+    r.name = x->soundfile_arrayname;
+    r.words = x->soundfile;
+    r.length = x->array_length;
+    r.channel = 0;
+    r.storage = x->storage;
+    r.format = x->precision;
+    r.cache_bytes = 0;
+    r.stamp = sample_buffer_stamp();
+    r.owner = NULL;
+    pd_granular_synth_tilde_request(x, &r);
+}
+
+/**
+ * @brief loads a soundfile on disk
+ * @details the loader maps and converts the file in the background. A streamed file gets a stream of its own for this object, every other storage shares the buffer of the file <br>
+ * @param x granular synth object <br>
+ * @param path path of the file <br>
+ * @param channel channel of the file that is played <br>
+ */
+static void pd_granular_synth_tilde_load_file(t_pd_granular_synth_tilde *x, t_symbol *path, int channel)
+{
+    sample_load_request r;
+
+    r.name = path;
+    r.words = NULL;
+    r.samples = NULL;
+    r.length = 0;
+    r.channel = channel;
+    r.storage = x->storage;
+    r.format = x->precision;
+    r.cache_bytes = (size_t)x->cache_size << 20;
+    r.stamp = 0;
+    r.owner = x;
+    x->loading_path = path;
+    x->loading_channel = channel;
+    pd_granular_synth_tilde_request(x, &r);
+}
+
+/**
+ * @brief binds the buffer the loader made
+ * @details runs on the clock of the object. The synth switches to the buffer between two dsp blocks and crossfades to it, a file becomes the soundfile of the object only once it could be opened.
+ * Reports every new buffer on the right outlet <br>
+ * @param x granular synth object <br>
+ */
+static void pd_granular_synth_tilde_poll(t_pd_granular_synth_tilde *x)
+{
+    sample_buffer *b;
+
+    if(sample_loader_poll(&x->loader, &b))
+    {
+        if(b && x->loading_path)
+        {
+            x->soundfile_path = x->loading_path;
+            x->soundfile_channel = x->loading_channel;
+        }
+        if(b)
+        {
+            pd_granular_synth_tilde_bind(x, b);
+        }
+        else if(x->loading_path)
+        {
+            pd_error(x, "pd_granular_synth~: can't open '%s', use a WAV or AIFF file with 16, 24 or 32 bit samples", x->loading_path->s_name);
+        }
+        else
+        {
+            pd_error(x, "pd_granular_synth~: not enough memory to load '%s'", x->soundfile_arrayname->s_name);
+        }
+    }
+    else if(sample_loader_busy(&x->loader))
+    {
+        clock_delay(x->load_clock, LOAD_POLL_MS);
+    }
+    if(x->ready_pending)
+    {
+        x->ready_pending = false;
+        outlet_float(x->out_ready, x->soundfile_length);
+    }
+}
+
 /**
  * @brief reads the array containing the loaded soundfile
- * @details reads the array containing the loaded soundfile, modified version of a method in the course's repository <br>
+ * @details reads the array containing the loaded soundfile, modified version of a method in the course's repository.
+ * The synth is made once and only swaps its sample buffer when the array was resized or reloaded or the storage changed, so restarting dsp keeps the playing grains.
+ * A changed array is loaded in the background while the synth keeps playing.
+ * If the array is gone a synth that reads it in place is freed and the object is silent <br>
  * @param x granular synth object that uses the soundfile's sample-data <br>
  */
 static void pd_granular_synth_tilde_getArray(t_pd_granular_synth_tilde *x, t_symbol *s)
@@ -173,22 +498,43 @@ static void pd_granular_synth_tilde_getArray(t_pd_granular_synth_tilde *x, t_sym
         post("Inner if-condition reached");
         x->soundfile = 0;
         }
+        if(x->synth && x->synth->buffer->storage == STORAGE_VIEW && x->synth->buffer->words)
+        {
+            c_granular_synth_free(x->synth);
+            x->synth = NULL;
+        }
         post("Get Array method if block reached");
     }
-    else if (!garray_getfloatwords(a, &x->soundfile_length, &x->soundfile))
+    else if (!garray_getfloatwords(a, &x->array_length, &x->soundfile))
     {
         post("Get Array method else if block reached"); 
     }
     else {
         garray_usedindsp(a);
 
-        x->soundfile_length = garray_npoints(a);
-        x->soundfile_length_ms = get_ms_from_samples(x->soundfile_length, x->sr);
-        x->synth = c_granular_synth_new(x->soundfile, x->soundfile_length, x->grain_size, x->start_pos, x->time_stretch_factor, x->attack, x->decay, x->sustain, x->release, x->gauss_q_factor, x->spray_input, x->pitch_factor, x->midi_pitch);
+        x->array_length = garray_npoints(a);
+        pd_granular_synth_tilde_load_array(x);
     }
     return;
 }
 
+/**
+ * @brief binds the synth to its soundfile
+ * @details plays the file of the @a open message if there is one, the array otherwise <br>
+ * @param x granular synth object <br>
+ */
+static void pd_granular_synth_tilde_rebind(t_pd_granular_synth_tilde *x)
+{
+    if(x->soundfile_path)
+    {
+        pd_granular_synth_tilde_load_file(x, x->soundfile_path, x->soundfile_channel);
+    }
+    else
+    {
+        pd_granular_synth_tilde_getArray(x, x->soundfile_arrayname);
+    }
+}
+
 /**
  * @related pd_granular_synth_tilde
  * @brief adds @a pd_granular_synth_tilde to the signal processing chain
@@ -196,8 +542,23 @@ static void pd_granular_synth_tilde_getArray(t_pd_granular_synth_tilde *x, t_sym
  */
 void pd_granular_synth_tilde_dsp(t_pd_granular_synth_tilde *x, t_signal **sp)
 {
-    pd_granular_synth_tilde_getArray(x, x->soundfile_arrayname);
-    dsp_add(pd_granular_synth_tilde_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
+    int n = sp[0]->s_n;
+    t_int args[PERFORM_NUM_ARGS];
+    
+    pd_granular_synth_tilde_rebind(x);
+    if(x->modulation_size != n)
+    {
+        free(x->modulation);
+        x->modulation = (t_sample *)malloc(NUM_MODULATIONS * n * sizeof(t_sample));
+        x->modulation_size = n;
+    }
+    args[0] = (t_int)x;
+    for(int s = 0; s <= NUM_MODULATIONS + 1; s++)
+    {
+        args[1 + s] = (t_int)sp[s]->s_vec;              ///< main inlet, modulation inlets and outlet in the order pd hands them over
+    }
+    args[PERFORM_NUM_ARGS - 1] = n;
+    dsp_addv(pd_granular_synth_tilde_perform, PERFORM_NUM_ARGS, args);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -214,6 +575,7 @@ static void pd_granular_synth_set_grain_size(t_pd_granular_synth_tilde *x, t_flo
         new_grain_size = x->soundfile_length;
         }
     x->grain_size = (int)new_grain_size;
+    pd_granular_synth_queue_event(x, EVENT_GRAIN_SIZE, x->grain_size, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -230,6 +592,7 @@ static void pd_granular_synth_set_start_pos(t_pd_granular_synth_tilde *x, t_floa
         new_start_pos = x->soundfile_length;
         }
     x->start_pos = new_start_pos;
+    pd_granular_synth_queue_event(x, EVENT_START_POS, x->start_pos, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -249,15 +612,18 @@ static void pd_granular_synth_set_time_stretch_factor(t_pd_granular_synth_tilde
         { 
             x->time_stretch_factor = (x->time_stretch_factor > 0) ? -0.1 : 0.1;
             x->synth->reverse_playback = !x->synth->reverse_playback; ///< inverts reverse playback state
+            pd_granular_synth_queue_event(x, EVENT_TIME_STRETCH, x->time_stretch_factor, 0);
             return;
         }
     }
     x->time_stretch_factor = new_time_stretch_factor;
+    pd_granular_synth_queue_event(x, EVENT_TIME_STRETCH, x->time_stretch_factor, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
  * @brief sets MIDI pitch/key
- * @details MIDI input pitch/key value, usable through virtual or external MIDI device <br>
+ * @details MIDI input pitch/key value, usable through virtual or external MIDI device, completes a note together with the velocity received right before (as sent by notein).
+ * A pitch without a velocity retunes the latest held note <br>
  * @param x input pointer of the @a pd_granular_synth_set_midi_pitch
  * @param f argument of type float for handling MIDI pitch/key input
  */
@@ -266,11 +632,19 @@ static void pd_granular_synth_set_midi_pitch(t_pd_granular_synth_tilde *x, t_flo
     int new_midi_pitch = (int)f;
     if(new_midi_pitch < 0) new_midi_pitch = 0;
     x->midi_pitch = (int)new_midi_pitch;
+    if(x->velo_pending)
+    {
+        pd_granular_synth_queue_note(x, x->velo_offset, x->midi_pitch, x->midi_velo);
+    }
+    else
+    {
+        pd_granular_synth_queue_event(x, EVENT_PITCH, x->midi_pitch, 0);
+    }
 }
 /**
  * @related t_pd_granular_synth_tilde
  * @brief sets MIDI velocity
- * @details MIDI input velocity value, usable through virtual or external MIDI device, also used for noteon detection <br>
+ * @details MIDI input velocity value, usable through virtual or external MIDI device, also used for noteon detection. If no pitch follows, the note is played with the last pitch at the sample the velocity arrived at <br>
  * @param x input pointer of the @a pd_granular_synth_set_midi_velo <br>
  * @param f argument of type float for handling MIDI velocity input <br>
  */
@@ -279,6 +653,37 @@ static void pd_granular_synth_set_midi_velo(t_pd_granular_synth_tilde *x, t_floa
     int new_midi_velo = (int)f;
     if(new_midi_velo < 0) new_midi_velo = 0;
     x->midi_velo = (int)new_midi_velo;
+    x->velo_offset = pd_granular_synth_event_offset(x);
+    x->velo_pending = true;
+}
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief plays a note
+ * @details note message with MIDI pitch/key and velocity, a velocity of 0 releases the note <br>
+ * @param x input pointer of the @a pd_granular_synth_note object <br>
+ * @param pitch argument of type float for the MIDI pitch/key <br>
+ * @param velo argument of type float for the MIDI velocity <br>
+ */
+static void pd_granular_synth_note(t_pd_granular_synth_tilde *x, t_floatarg pitch, t_floatarg velo)
+{
+    if(pitch < 0) pitch = 0;
+    if(velo < 0) velo = 0;
+    pd_granular_synth_queue_note(x, pd_granular_synth_event_offset(x), (t_int)pitch, (t_int)velo);
+}
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief sets number of voices
+ * @details sets how many notes the density based scheduler plays at once, the oldest or quietest voice is stolen when all are in use <br>
+ * @param x input pointer of the @a pd_granular_synth_set_num_voices object <br>
+ * @param f argument of type float in the range of 1 - @a MAX_VOICES <br>
+ */
+static void pd_granular_synth_set_num_voices(t_pd_granular_synth_tilde *x, t_floatarg f)
+{
+    int new_num_voices = (int)f;
+    if(new_num_voices < 1) new_num_voices = 1;
+    if(new_num_voices > MAX_VOICES) new_num_voices = MAX_VOICES;
+    x->num_voices = new_num_voices;
+    pd_granular_synth_queue_event(x, EVENT_VOICES, x->num_voices, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -292,6 +697,7 @@ static void pd_granular_synth_set_attack(t_pd_granular_synth_tilde *x, t_floatar
     int new_attack = (int)f;
     if(new_attack < 0) new_attack = 0;
     x->attack = (int)new_attack;
+    pd_granular_synth_queue_event(x, EVENT_ATTACK, x->attack, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -305,6 +711,7 @@ static void pd_granular_synth_set_decay(t_pd_granular_synth_tilde *x, t_floatarg
     int new_decay = (int)f;
     if(new_decay < 0) new_decay = 0;
     x->decay = (int)new_decay;
+    pd_granular_synth_queue_event(x, EVENT_DECAY, x->decay, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -318,6 +725,7 @@ static void pd_granular_synth_set_sustain(t_pd_granular_synth_tilde *x, t_floata
     float new_sustain = (float)f;
     if(new_sustain < 0) new_sustain = 0;
     x->sustain = (float)new_sustain;
+    pd_granular_synth_queue_event(x, EVENT_SUSTAIN, x->sustain, 0);
 }
 /**
  * @related t_pd_granular_synth_tilde
@@ -331,6 +739,7 @@ static void pd_granular_synth_set_release(t_pd_granular_synth_tilde *x, t_floata
     int new_release = (int)f;
     if(new_release < 0) new_release = 0;
     x->release = (int)new_release;
+    pd_granular_synth_queue_event(x, EVENT_RELEASE, x->release, 0);
 }
 
 /**
@@ -345,6 +754,7 @@ static void pd_granular_synth_set_gauss_q_factor(t_pd_granular_synth_tilde *x, t
     float new_gauss_q_factor = f;
     if(new_gauss_q_factor < 0) new_gauss_q_factor = 0;
     x->gauss_q_factor = (float)new_gauss_q_factor;
+    pd_granular_synth_queue_event(x, EVENT_GAUSS_Q, x->gauss_q_factor, 0);
 }
 
 /**
@@ -357,6 +767,281 @@ static void pd_granular_synth_set_spray_input(t_pd_granular_synth_tilde *x, t_fl
 {
     int new_spray = (int)f;
     x->spray_input = get_samples_from_ms(new_spray, x->sr);
+    pd_granular_synth_queue_event(x, EVENT_SPRAY, x->spray_input, 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief selects the grain scheduler
+ * @details "table" lays out grains over the whole soundfile, "density" creates grains on demand according to the grain density <br>
+ * @param x input pointer of the @a pd_granular_synth_set_scheduler object <br>
+ * @param s name of the scheduler <br>
+ */
+static void pd_granular_synth_set_scheduler(t_pd_granular_synth_tilde *x, t_symbol *s)
+{
+    if(s == gensym("table"))
+    {
+        x->scheduler = SCHEDULE_TABLE;
+    }
+    else if(s == gensym("density"))
+    {
+        x->scheduler = SCHEDULE_DENSITY;
+    }
+    else
+    {
+        pd_error(x, "pd_granular_synth~: unknown scheduler '%s', use 'table' or 'density'", s->s_name);
+        return;
+    }
+    pd_granular_synth_queue_event(x, EVENT_SCHEDULER, x->scheduler, 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief selects the grain window
+ * @details "gauss", "hann", "tukey" or "blackman", the gauss q factor inlet also sets the taper ratio of the tukey window <br>
+ * @param x input pointer of the @a pd_granular_synth_set_window object <br>
+ * @param s name of the window <br>
+ */
+static void pd_granular_synth_set_window(t_pd_granular_synth_tilde *x, t_symbol *s)
+{
+    if(s == gensym("gauss"))
+    {
+        x->window_shape = WINDOW_GAUSS;
+    }
+    else if(s == gensym("hann"))
+    {
+        x->window_shape = WINDOW_HANN;
+    }
+    else if(s == gensym("tukey"))
+    {
+        x->window_shape = WINDOW_TUKEY;
+    }
+    else if(s == gensym("blackman"))
+    {
+        x->window_shape = WINDOW_BLACKMAN;
+    }
+    else
+    {
+        pd_error(x, "pd_granular_synth~: unknown window '%s', use 'gauss', 'hann', 'tukey' or 'blackman'", s->s_name);
+        return;
+    }
+    pd_granular_synth_queue_event(x, EVENT_WINDOW, x->window_shape, 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief selects the interpolation
+ * @details "linear", "hermite" (4 point) or "sinc" (8 point windowed sinc), the higher orders read the soundfile with less dulling and aliasing when the pitch is far from the original <br>
+ * @param x input pointer of the @a pd_granular_synth_set_interpolation object <br>
+ * @param s name of the interpolation <br>
+ */
+static void pd_granular_synth_set_interpolation(t_pd_granular_synth_tilde *x, t_symbol *s)
+{
+    if(s == gensym("linear"))
+    {
+        x->interpolation = INTERPOLATE_LINEAR;
+    }
+    else if(s == gensym("hermite"))
+    {
+        x->interpolation = INTERPOLATE_HERMITE;
+    }
+    else if(s == gensym("sinc"))
+    {
+        x->interpolation = INTERPOLATE_SINC;
+    }
+    else
+    {
+        pd_error(x, "pd_granular_synth~: unknown interpolation '%s', use 'linear', 'hermite' or 'sinc'", s->s_name);
+        return;
+    }
+    pd_granular_synth_queue_event(x, EVENT_INTERPOLATION, x->interpolation, 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief selects how the synth stores the array
+ * @details "copy" copies the array into its own tables with band limited levels for fast grains, "view" reads the array in place without copying it, edits of the array are heard immediately but fast grains alias.
+ * "stream" decodes a file opened with @a open block by block around the start position into a cache of the size set by the @a cache message, for files too long to be held in memory. Grains that reach a block that is not loaded yet fade out, fast grains alias. An array is copied.
+ * The playing grains crossfade to the new storage <br>
+ * @param x input pointer of the @a pd_granular_synth_set_storage object <br>
+ * @param s name of the storage <br>
+ */
+static void pd_granular_synth_set_storage(t_pd_granular_synth_tilde *x, t_symbol *s)
+{
+    if(s == gensym("copy"))
+    {
+        x->storage = STORAGE_COPY;
+    }
+    else if(s == gensym("view"))
+    {
+        x->storage = STORAGE_VIEW;
+    }
+    else if(s == gensym("stream"))
+    {
+        x->storage = STORAGE_STREAM;
+    }
+    else
+    {
+        pd_error(x, "pd_granular_synth~: unknown storage '%s', use 'copy', 'view' or 'stream'", s->s_name);
+        return;
+    }
+    if(x->synth)
+    {
+        pd_granular_synth_tilde_rebind(x);
+    }
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief selects the format a copied soundfile is stored in
+ * @details "float" stores 32 bit floats, "int16" 16 bit integers rounded with dither and "half" 16 bit floats. The 16 bit formats halve the memory of the copy and of its band limited levels and the memory every grain reads, the kernels widen the samples to float as they read them.
+ * 16 bit files lose nothing as int16. Views and streams always read floats. The playing grains crossfade to the new copy <br>
+ * @param x input pointer of the @a pd_granular_synth_set_precision object <br>
+ * @param s name of the format <br>
+ */
+static void pd_granular_synth_set_precision(t_pd_granular_synth_tilde *x, t_symbol *s)
+{
+    if(s == gensym("float"))
+    {
+        x->precision = SAMPLE_FLOAT32;
+    }
+    else if(s == gensym("int16"))
+    {
+        x->precision = SAMPLE_INT16;
+    }
+    else if(s == gensym("half"))
+    {
+        x->precision = SAMPLE_HALF;
+    }
+    else
+    {
+        pd_error(x, "pd_granular_synth~: unknown precision '%s', use 'float', 'int16' or 'half'", s->s_name);
+        return;
+    }
+    if(x->synth)
+    {
+        pd_granular_synth_tilde_rebind(x);
+    }
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief sets the size of the block cache
+ * @details memory a streamed file uses no matter how long it is, the cache should hold the spray range and the reach of the grains around the start position. A playing stream crossfades to a stream with the new cache <br>
+ * @param x input pointer of the @a pd_granular_synth_set_cache_size object <br>
+ * @param f argument of type float for the size in megabytes <br>
+ */
+static void pd_granular_synth_set_cache_size(t_pd_granular_synth_tilde *x, t_floatarg f)
+{
+    int new_cache_size = (int)f;
+    if(new_cache_size < 1) new_cache_size = 1;
+    if(new_cache_size == x->cache_size) return;
+    x->cache_size = new_cache_size;
+    if(x->synth && x->soundfile_path && x->storage == STORAGE_STREAM)
+    {
+        pd_granular_synth_tilde_rebind(x);
+    }
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief plays a soundfile from disk
+ * @details maps a WAV or AIFF file instead of reading the array, nothing is decoded up front. With storage "view" 32 bit float files are read straight from the mapping and the operating system loads their pages when grains first reach them, with storage "stream" only the region around the start position is decoded, all other files are converted once.
+ * The file is loaded in the background, the synth keeps playing until it is ready and reports it on the right outlet.
+ * Relative paths start at the directory of the patch, without a path the array is played again <br>
+ * @param x input pointer of the @a pd_granular_synth_open object <br>
+ * @param s path of the file <br>
+ * @param f channel of the file that is played, starting at 0 <br>
+ */
+static void pd_granular_synth_open(t_pd_granular_synth_tilde *x, t_symbol *s, t_floatarg f)
+{
+    char filename[MAXPDSTRING];
+    
+    if(!*s->s_name)
+    {
+        x->soundfile_path = NULL;
+        pd_granular_synth_tilde_rebind(x);
+        return;
+    }
+    canvas_makefilename(x->canvas, s->s_name, filename, MAXPDSTRING);
+    pd_granular_synth_tilde_load_file(x, gensym(filename), (f > 0) ? (int)f : 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief loads the soundfile again
+ * @details pd does not tell when an array is written, restarting dsp only loads an array again once it was resized. Send @a reload after writing the array, every copy of it is made again from its current samples.
+ * A file is loaded again anyway once it was written on disk. The playing grains crossfade to the new buffer <br>
+ * @param x input pointer of the @a pd_granular_synth_reload object <br>
+ */
+static void pd_granular_synth_reload(t_pd_granular_synth_tilde *x)
+{
+    if(!x->soundfile_path)
+    {
+        sample_buffer_outdate(x->soundfile_arrayname);
+    }
+    pd_granular_synth_tilde_rebind(x);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief sets grain density
+ * @details sets the number of grains per second started by the density based scheduler <br>
+ * @param x input pointer of the @a pd_granular_synth_set_grain_density object <br>
+ * @param f argument of type float for handling grain density input <br>
+ */
+static void pd_granular_synth_set_grain_density(t_pd_granular_synth_tilde *x, t_floatarg f)
+{
+    float new_grain_density = f;
+    if(new_grain_density < 0) new_grain_density = 0;
+    x->grain_density = new_grain_density;
+    pd_granular_synth_queue_event(x, EVENT_DENSITY, x->grain_density, 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief sets inter-onset interval
+ * @details sets the time between two grain onsets of the density based scheduler in ms, equivalent to setting the grain density <br>
+ * @param x input pointer of the @a pd_granular_synth_set_onset_interval object <br>
+ * @param f argument of type float for handling the interval in ms <br>
+ */
+static void pd_granular_synth_set_onset_interval(t_pd_granular_synth_tilde *x, t_floatarg f)
+{
+    if(f <= 0) return;
+    x->grain_density = 1000.0 / f;
+    pd_granular_synth_queue_event(x, EVENT_DENSITY, x->grain_density, 0);
+}
+
+/**
+ * @related t_pd_granular_synth_tilde
+ * @brief sets a glide time
+ * @details "start_pos", "grain_size" or "time_stretch_factor" followed by the time in ms the parameter glides to a new value. New grains take the value of the glide at their onset, grains that are playing are left alone, 0 sets the parameter right away <br>
+ * @param x input pointer of the @a pd_granular_synth_set_ramp object <br>
+ * @param s name of the parameter <br>
+ * @param f glide time in ms <br>
+ */
+static void pd_granular_synth_set_ramp(t_pd_granular_synth_tilde *x, t_symbol *s, t_floatarg f)
+{
+    enum synth_ramp r;
+    if(s == gensym("start_pos"))
+    {
+        r = RAMP_START_POS;
+    }
+    else if(s == gensym("grain_size"))
+    {
+        r = RAMP_GRAIN_SIZE;
+    }
+    else if(s == gensym("time_stretch_factor"))
+    {
+        r = RAMP_TIME_STRETCH;
+    }
+    else
+    {
+        pd_error(x, "pd_granular_synth~: no ramp for '%s', use 'start_pos', 'grain_size' or 'time_stretch_factor'", s->s_name);
+        return;
+    }
+    x->ramp_time[r] = (f > 0) ? (int)f : 0;
+    if(x->synth) c_granular_synth_set_ramp_time(x->synth, r, x->ramp_time[r]);
 }
 
 /**
@@ -401,6 +1086,32 @@ void pd_granular_synth_tilde_setup(void)
         gensym("sustain"), A_DEFFLOAT, 0);
       class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_release,
         gensym("release"), A_DEFFLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_note,
+        gensym("note"), A_FLOAT, A_FLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_num_voices,
+        gensym("voices"), A_DEFFLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_scheduler,
+        gensym("scheduler"), A_DEFSYMBOL, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_window,
+        gensym("window"), A_DEFSYMBOL, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_interpolation,
+        gensym("interpolation"), A_DEFSYMBOL, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_storage,
+        gensym("storage"), A_DEFSYMBOL, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_precision,
+        gensym("precision"), A_DEFSYMBOL, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_cache_size,
+        gensym("cache"), A_DEFFLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_open,
+        gensym("open"), A_DEFSYMBOL, A_DEFFLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_reload,
+        gensym("reload"), 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_grain_density,
+        gensym("density"), A_DEFFLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_onset_interval,
+        gensym("interval"), A_DEFFLOAT, 0);
+      class_addmethod(pd_granular_synth_tilde_class, (t_method)pd_granular_synth_set_ramp,
+        gensym("ramp"), A_DEFSYMBOL, A_DEFFLOAT, 0);
 
       CLASS_MAINSIGNALIN(pd_granular_synth_tilde_class, t_pd_granular_synth_tilde, f);   
 }
@@ -67,6 +67,23 @@ float get_interpolated_sample_value(float sample_left, float sample_right, float
     float weighted_b = sample_right * frac;
     return (weighted_a + weighted_b);
 }
+/**
+ * @brief calculates the hermite interpolated value between two samples
+ * @details 4 point, 3rd order hermite (catmull-rom) interpolation between @a sample_left and @a sample_right <br>
+ * @param sample_before sample before @a sample_left <br>
+ * @param sample_left sample at the left of the read position <br>
+ * @param sample_right sample at the right of the read position <br>
+ * @param sample_after sample after @a sample_right <br>
+ * @param frac distance of the read position from @a sample_left in the range of 0 - 1 <br>
+ * @return float interpolated value <br>
+ */
+float get_hermite_sample_value(float sample_before, float sample_left, float sample_right, float sample_after, float frac)
+{
+    float c1 = 0.5f * (sample_right - sample_before);
+    float c2 = sample_before - 2.5f * sample_left + 2.0f * sample_right - 0.5f * sample_after;
+    float c3 = 0.5f * (sample_after - sample_before) + 1.5f * (sample_left - sample_right);
+    return ((c3 * frac + c2) * frac + c1) * frac + sample_left;
+}
 /**
  * @brief swaps to values
  * @details swaps to values @a a with @a b using a temporary third pointer <br>
@@ -92,3 +109,64 @@ int spray_dependant_playback_nudge(int spray_input)
     int off = rand() % (2 * spray_input);
     return off - spray_input;
 }
+
+/**
+ * @brief rounds a size up to the arena alignment
+ * @details used to add up the size an arena needs for a set of buffers <br>
+ * @param size size in bytes <br>
+ * @return size_t aligned size <br>
+ */
+size_t purple_arena_aligned_size(size_t size)
+{
+    return (size + PURPLE_ARENA_ALIGNMENT - 1) & ~((size_t)PURPLE_ARENA_ALIGNMENT - 1);
+}
+/**
+ * @brief allocates the memory of an arena
+ * @details the only allocator call of an arena, happens outside of the dsp path <br>
+ * @param a pointer to the arena <br>
+ * @param size usable size in bytes <br>
+ * @return true on success <br>
+ */
+bool purple_arena_init(purple_arena *a, size_t size)
+{
+    a->memory = (char *) malloc(size + PURPLE_ARENA_ALIGNMENT);
+    a->used = 0;
+    if(!a->memory)
+    {
+        a->base = NULL;
+        a->size = 0;
+        return false;
+    }
+    a->base = (char *)purple_arena_aligned_size((size_t)a->memory);
+    a->size = size;
+    return true;
+}
+/**
+ * @brief hands out memory of an arena
+ * @details every block starts on a @a PURPLE_ARENA_ALIGNMENT boundary, memory is only given back by releasing the whole arena <br>
+ * @param a pointer to the arena <br>
+ * @param size size in bytes <br>
+ * @return pointer to the block, NULL if the arena is exhausted <br>
+ */
+void *purple_arena_alloc(purple_arena *a, size_t size)
+{
+    size = purple_arena_aligned_size(size);
+    if(!a->base || a->used + size > a->size) return NULL;
+    
+    void *block = a->base + a->used;
+    a->used += size;
+    return block;
+}
+/**
+ * @brief frees the memory of an arena
+ * @details invalidates all blocks handed out by the arena <br>
+ * @param a pointer to the arena <br>
+ */
+void purple_arena_release(purple_arena *a)
+{
+    free(a->memory);
+    a->memory = NULL;
+    a->base = NULL;
+    a->size = 0;
+    a->used = 0;
+}
@@ -15,9 +15,159 @@
 #ifndef purple_utils_h
 #define purple_utils_h
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#define PURPLE_ARENA_ALIGNMENT 64               ///< alignment of every arena allocation in bytes, one cache line <br>
+
+#define FIXED_FRACTION_BITS 32                  ///< number of fractional bits of a @a fixed_position <br>
+#define FIXED_ONE ((fixed_position)1 << FIXED_FRACTION_BITS)  ///< one sample as @a fixed_position <br>
+#define FIXED_FRACTION_MASK (FIXED_ONE - 1)     ///< fractional bits of a @a fixed_position <br>
+
+/**
+ * @brief read position in the soundfile as 32.32 fixed point
+ * @details the upper 32 bits are the sample index, the lower 32 bits the position between two samples.
+ * Unlike a float the resolution does not depend on the distance to the start of the soundfile <br>
+ */
+typedef int64_t fixed_position;
+
+/**
+ * @brief converts samples to a fixed point position
+ * @param value position or step in samples <br>
+ * @return fixed_position rounded to the nearest fixed point value <br>
+ */
+static inline fixed_position fixed_from_float(double value)
+{
+    return (fixed_position)llround(value * FIXED_ONE);
+}
+/**
+ * @brief sample index of a fixed point position
+ * @param position fixed point position <br>
+ * @return int index of the sample left of @a position <br>
+ */
+static inline int fixed_index(fixed_position position)
+{
+    return (int)(position >> FIXED_FRACTION_BITS);
+}
+/**
+ * @brief position between two samples
+ * @param position fixed point position <br>
+ * @return float fraction in the range of 0 - 1 <br>
+ */
+static inline float fixed_frac(fixed_position position)
+{
+    return (float)(position & FIXED_FRACTION_MASK) * (1.0f / 4294967296.0f);
+}
+/**
+ * @brief wraps a fixed point position into the soundfile
+ * @param position fixed point position, may lie outside of the soundfile <br>
+ * @param wrap read positions wrap around at this value <br>
+ * @return fixed_position position in the range of 0 - @a wrap, 0 if @a wrap is not positive <br>
+ */
+static inline fixed_position fixed_wrap(fixed_position position, fixed_position wrap)
+{
+    if(wrap <= 0) return 0;
+    if(position >= wrap || position < 0)
+    {
+        position %= wrap;
+        if(position < 0) position += wrap;
+    }
+    return position;
+}
+
+/**
+ * @struct purple_ramp
+ * @brief linear glide of a parameter to a target value
+ * @details the value moves by @a increment per sample until @a remaining reaches 0 and equals @a target from then on <br>
+ */
+typedef struct purple_ramp
+{
+    float       value,                          ///< value at the current sample <br>
+                target,                         ///< value the ramp arrives at <br>
+                increment;                      ///< change of @a value per sample <br>
+    int         remaining;                      ///< samples left until @a target is reached, 0 while the ramp stands still <br>
+} purple_ramp;
+
+/**
+ * @brief sets the value of a ramp right away
+ * @param r pointer to the ramp <br>
+ * @param value new value <br>
+ */
+static inline void purple_ramp_jump(purple_ramp *r, float value)
+{
+    r->value = value;
+    r->target = value;
+    r->increment = 0;
+    r->remaining = 0;
+}
+/**
+ * @brief glides from the current value to a new target
+ * @param r pointer to the ramp <br>
+ * @param target value the ramp arrives at <br>
+ * @param num_samples length of the glide, values <= 0 jump <br>
+ */
+static inline void purple_ramp_set(purple_ramp *r, float target, int num_samples)
+{
+    if(num_samples <= 0)
+    {
+        purple_ramp_jump(r, target);
+        return;
+    }
+    r->target = target;
+    r->increment = (target - r->value) / num_samples;
+    r->remaining = num_samples;
+}
+/**
+ * @brief value of a ramp a few samples ahead
+ * @param r pointer to the ramp <br>
+ * @param k samples after the current sample <br>
+ * @return float value at sample @a k <br>
+ */
+static inline float purple_ramp_value_at(const purple_ramp *r, int k)
+{
+    return (k < r->remaining) ? r->value + r->increment * k : r->target;
+}
+/**
+ * @brief moves a ramp on
+ * @param r pointer to the ramp <br>
+ * @param num_samples number of samples that passed <br>
+ */
+static inline void purple_ramp_advance(purple_ramp *r, int num_samples)
+{
+    if(r->remaining == 0) return;
+    if(num_samples >= r->remaining)
+    {
+        r->value = r->target;
+        r->remaining = 0;
+        return;
+    }
+    r->value += r->increment * num_samples;
+    r->remaining -= num_samples;
+}
+
+/**
+ * @struct purple_arena
+ * @brief per-instance memory arena
+ * @details one block allocated when the synth is created, all buffers of the dsp path are carved out of it, so the audio thread never calls the allocator <br>
+ */
+typedef struct purple_arena
+{
+    char        *memory;                        ///< start of the allocated block <br>
+    char        *base;                          ///< @a memory aligned to @a PURPLE_ARENA_ALIGNMENT <br>
+    size_t      size,                           ///< usable size in bytes <br>
+                used;                           ///< bytes handed out so far <br>
+} purple_arena;
+
+bool purple_arena_init(purple_arena *a, size_t size);
+void *purple_arena_alloc(purple_arena *a, size_t size);
+size_t purple_arena_aligned_size(size_t size);
+void purple_arena_release(purple_arena *a);
 int get_samples_from_ms(int ms, float sr);
 float get_ms_from_samples(int num_samples, float sr);
 float get_interpolated_sample_value(float sample_left, float sample_right, float frac);
+float get_hermite_sample_value(float sample_before, float sample_left, float sample_right, float sample_after, float frac);
 void switch_float_values(float *a, float *b);
 int spray_dependant_playback_nudge(int spray_input);
 
@@ -0,0 +1,94 @@
+/**
+ * @file purple_worker.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief background thread of the synth
+ * @details runs work that is too slow for the dsp routine, the dsp routine only sets a flag and signals the thread, it never waits for the job <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include "purple_worker.h"
+
+/**
+ * @brief main loop of the worker thread
+ * @details sleeps until @a pending or @a quit is set, the job runs without the mutex <br>
+ * @param arg pointer to the @a purple_worker <br>
+ * @return NULL <br>
+ */
+static void *purple_worker_run(void *arg)
+{
+    purple_worker *w = (purple_worker *)arg;
+    
+    pthread_mutex_lock(&w->mutex);
+    while(true)
+    {
+        while(!w->pending && !atomic_load(&w->quit))
+        {
+            pthread_cond_wait(&w->wake_up, &w->mutex);
+        }
+        if(atomic_load(&w->quit)) break;
+        
+        w->pending = false;
+        pthread_mutex_unlock(&w->mutex);
+        w->job(w->owner);
+        pthread_mutex_lock(&w->mutex);
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+/**
+ * @brief starts a worker thread
+ * @param w pointer to the worker <br>
+ * @param job function the thread runs when it is woken <br>
+ * @param owner argument of @a job <br>
+ * @return true if the thread is running, otherwise the caller has to do the work itself <br>
+ */
+bool purple_worker_start(purple_worker *w, purple_worker_job job, void *owner)
+{
+    w->job = job;
+    w->owner = owner;
+    w->pending = false;
+    atomic_init(&w->quit, false);
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->wake_up, NULL);
+    w->running = (pthread_create(&w->thread, NULL, purple_worker_run, w) == 0);
+    return w->running;
+}
+/**
+ * @brief wakes the worker thread
+ * @details safe to call from the dsp routine, the mutex is only held by the worker while it checks its flags, never while the job runs <br>
+ * @param w pointer to the worker <br>
+ */
+void purple_worker_wake(purple_worker *w)
+{
+    pthread_mutex_lock(&w->mutex);
+    w->pending = true;
+    pthread_cond_signal(&w->wake_up);
+    pthread_mutex_unlock(&w->mutex);
+}
+/**
+ * @brief stops a worker thread
+ * @details waits for a running job to finish <br>
+ * @param w pointer to the worker <br>
+ */
+void purple_worker_stop(purple_worker *w)
+{
+    if(w->running)
+    {
+        pthread_mutex_lock(&w->mutex);
+        atomic_store(&w->quit, true);
+        pthread_cond_signal(&w->wake_up);
+        pthread_mutex_unlock(&w->mutex);
+        pthread_join(w->thread, NULL);
+        w->running = false;
+    }
+    pthread_mutex_destroy(&w->mutex);
+    pthread_cond_destroy(&w->wake_up);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file purple_worker.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a purple_worker.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef purple_worker_h
+#define purple_worker_h
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief job of a worker thread
+ * @param owner pointer handed to @a purple_worker_start <br>
+ */
+typedef void (*purple_worker_job)(void *owner);
+
+/**
+ * @struct purple_worker
+ * @brief background thread for work that must not run in the dsp routine
+ * @details the thread sleeps until it is woken and then runs its job once, several wake ups before the job runs are merged into one run <br>
+ */
+typedef struct purple_worker
+{
+    pthread_t           thread;                 ///< the worker thread <br>
+    pthread_mutex_t     mutex;                  ///< guards @a pending and the setting of @a quit <br>
+    pthread_cond_t      wake_up;                ///< signalled by @a purple_worker_wake <br>
+    bool                pending;                ///< set when the job has to run <br>
+    atomic_bool         quit;                   ///< set when the thread has to end, a long job may check it while it runs <br>
+    bool                running;                ///< false if the thread could not be started <br>
+    purple_worker_job   job;                    ///< function run by the thread <br>
+    void                *owner;                 ///< argument of @a job <br>
+} purple_worker;
+
+bool purple_worker_start(purple_worker *w, purple_worker_job job, void *owner);
+void purple_worker_wake(purple_worker *w);
+void purple_worker_stop(purple_worker *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,594 @@
+/**
+ * @file sample_buffer.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief the soundfile as the grains read it
+ * @details copies the pd array or a mapped soundfile into a table with guard samples and builds its pyramid, optionally stored in 16 bits, wraps the samples in place or streams a file through a block cache.
+ * All buffers live in one cache of the process, a buffer is made once per array and shared by every synth that reads it until the last one releases it or the array is reloaded <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "sample_buffer.h"
+
+static sample_buffer *sample_buffer_cache = NULL;                           ///< every buffer in use <br>
+static pthread_mutex_t sample_buffer_cache_mutex = PTHREAD_MUTEX_INITIALIZER;    ///< guards @a sample_buffer_cache, the reference counts and @a sample_buffer_cache_stamp <br>
+static unsigned sample_buffer_cache_stamp = 0;                              ///< number of times an array was reloaded <br>
+
+/**
+ * @brief frees a buffer
+ * @param b the buffer, may be NULL <br>
+ */
+static void sample_buffer_free(sample_buffer *b)
+{
+    if(b)
+    {
+        sample_stream_stop(b->stream);
+        purple_arena_release(&b->arena);
+        mapped_soundfile_close(&b->file);
+        free(b);
+    }
+}
+/**
+ * @brief allocates a buffer
+ * @param name name of the array or path of the file <br>
+ * @param storage storage the buffer is asked for <br>
+ * @return sample_buffer* without samples, NULL if the memory could not be allocated <br>
+ */
+static sample_buffer *sample_buffer_alloc(t_symbol *name, enum soundfile_storage storage)
+{
+    sample_buffer *b = (sample_buffer *)calloc(1, sizeof(sample_buffer));
+    if(!b) return NULL;
+    b->name = name;
+    b->requested_storage = storage;
+    b->refcount = 1;
+    return b;
+}
+/**
+ * @brief lets a buffer read samples in place
+ * @param b the buffer <br>
+ * @param samples first sample <br>
+ * @param length number of samples <br>
+ * @param stride distance between two samples in floats <br>
+ */
+static void sample_buffer_view(sample_buffer *b, const float *samples, int length, int stride)
+{
+    purple_arena_init(&b->arena, 0);
+    b->storage = STORAGE_VIEW;
+    b->length = length;
+    b->stride = stride;
+    b->table = NULL;
+    mipmap_view(&b->pyramid, (float *)samples, length);
+}
+/**
+ * @brief reserves the table of a buffer that copies its samples
+ * @details the pyramid is built by @a mipmap_build once the table is filled <br>
+ * @param b the buffer <br>
+ * @param length number of samples <br>
+ * @return true on success <br>
+ */
+static bool sample_buffer_reserve_table(sample_buffer *b, int length)
+{
+    if(!purple_arena_init(&b->arena, mipmap_table_size(length) + mipmap_arena_size(length, true))) return false;
+    b->storage = STORAGE_COPY;
+    b->length = length;
+    b->stride = 1;
+    b->table = mipmap_table_alloc(&b->arena, length);
+    return b->table != NULL;
+}
+/**
+ * @brief stores the copy of a buffer in 16 bits
+ * @details converts the built pyramid into an arena of its own and frees the float levels, the copy then needs half the memory and half the memory bandwidth per grain.
+ * A buffer whose 16 bit arena or levels cannot be allocated stays float <br>
+ * @param b the buffer, with its table filled and its pyramid built <br>
+ * @param format format of the copy <br>
+ */
+static void sample_buffer_compact(sample_buffer *b, enum sample_format format)
+{
+    purple_arena floats = b->arena;
+
+    if(format == SAMPLE_FLOAT32 || b->length < 2) return;
+    if(!purple_arena_init(&b->arena, mipmap_compact_arena_size(b->length, b->pyramid.reversed != NULL)))
+    {
+        b->arena = floats;
+        return;
+    }
+    if(!mipmap_compact(&b->pyramid, &b->arena, b->length, format))
+    {
+        purple_arena_release(&b->arena);
+        b->arena = floats;
+        return;
+    }
+    purple_arena_release(&floats);
+    b->table = NULL;
+}
+/**
+ * @brief checks whether a pd array is read in place
+ * @details the array is read as floats in place only by a single precision build of pd <br>
+ * @param storage storage the buffer is asked for <br>
+ * @return true if nothing is copied <br>
+ */
+static bool sample_buffer_is_view(enum soundfile_storage storage)
+{
+    return storage == STORAGE_VIEW && sizeof(t_float) == sizeof(float);
+}
+/**
+ * @brief makes a buffer of a pd array
+ * @details the array is read as floats in place only by a single precision build of pd, otherwise it is copied <br>
+ * @param name name of the array <br>
+ * @param soundfile words of the pd array, has to outlive the buffer if it is read in place <br>
+ * @param samples samples of the array the copy is made from, NULL to copy @a soundfile <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param storage whether the soundfile is copied or read in place <br>
+ * @param format format a copy is stored in <br>
+ * @return sample_buffer*, NULL if the memory could not be allocated <br>
+ */
+static sample_buffer *sample_buffer_new(t_symbol *name, t_word *soundfile, const float *samples, int soundfile_length, enum soundfile_storage storage,
+                                        enum sample_format format)
+{
+    sample_buffer *b = sample_buffer_alloc(name, storage);
+    if(!b) return NULL;
+    b->words = soundfile;
+    b->requested_format = format;
+
+    if(sample_buffer_is_view(storage))
+    {
+        sample_buffer_view(b, (const float *)&soundfile->w_float, soundfile_length, sizeof(t_word) / sizeof(float));
+        return b;
+    }
+
+    if(!sample_buffer_reserve_table(b, soundfile_length))
+    {
+        sample_buffer_free(b);
+        return NULL;
+    }
+    for(int i = 0; i < soundfile_length; i++)
+    {
+        b->table[i] = samples ? samples[i] : soundfile[i].w_float;
+    }
+    if(!mipmap_build(&b->pyramid, &b->arena, b->table, soundfile_length, true))
+    {
+        sample_buffer_free(b);
+        return NULL;
+    }
+    sample_buffer_compact(b, format);
+    return b;
+}
+/**
+ * @brief makes a buffer of a soundfile on disk
+ * @details the file is mapped. Single precision samples in the byte order of the CPU are read in place from the mapping if @a storage asks for it, the operating system then loads them when grains first read them.
+ * A streamed file stays mapped and is decoded block by block by the reader thread of its stream, files shorter than 2 samples are copied.
+ * All other files are converted from the mapping into a table, stored in @a format, and unmapped again <br>
+ * @param path path of the WAV or AIFF file <br>
+ * @param channel channel of the file that is played <br>
+ * @param storage whether the soundfile is copied, read in place or streamed <br>
+ * @param version version of the file on disk <br>
+ * @param cache_bytes size of the block cache of a streamed file <br>
+ * @param format format a copy is stored in <br>
+ * @return sample_buffer*, NULL if the file cannot be played or the memory could not be allocated <br>
+ */
+static sample_buffer *sample_buffer_new_file(t_symbol *path, int channel, enum soundfile_storage storage, int64_t version, size_t cache_bytes, enum sample_format format)
+{
+    sample_buffer *b = sample_buffer_alloc(path, storage);
+    const float *samples;
+
+    if(!b) return NULL;
+    b->channel = channel;
+    b->version = version;
+    b->cache_bytes = cache_bytes;
+    b->requested_format = format;
+    if(!mapped_soundfile_open(&b->file, path->s_name))
+    {
+        free(b);
+        return NULL;
+    }
+    if(channel >= b->file.num_channels) channel = b->file.num_channels - 1;
+
+    if(storage == STORAGE_VIEW && (samples = mapped_soundfile_floats(&b->file)))
+    {
+        sample_buffer_view(b, samples + channel, b->file.num_frames, b->file.num_channels);
+        return b;
+    }
+
+    if(storage == STORAGE_STREAM && b->file.num_frames >= 2 &&
+       purple_arena_init(&b->arena, sample_stream_arena_size(b->file.num_frames, cache_bytes)))
+    {
+        if((b->stream = sample_stream_new(&b->arena, &b->file, channel, cache_bytes)))
+        {
+            b->storage = STORAGE_STREAM;
+            b->length = b->file.num_frames;
+            b->stride = 1;
+            b->table = NULL;
+            return b;
+        }
+        purple_arena_release(&b->arena);
+    }
+
+    if(!sample_buffer_reserve_table(b, b->file.num_frames))
+    {
+        sample_buffer_free(b);
+        return NULL;
+    }
+    for(int i = 0; i < b->length; i++)
+    {
+        b->table[i] = mapped_soundfile_sample(&b->file, i, channel);
+    }
+    if(!mipmap_build(&b->pyramid, &b->arena, b->table, b->length, true))
+    {
+        sample_buffer_free(b);
+        return NULL;
+    }
+    sample_buffer_compact(b, format);
+    mapped_soundfile_close(&b->file);
+    return b;
+}
+/**
+ * @brief checks whether a buffer still holds a pd array
+ * @details compares the identity of the array, never its samples, so restarting dsp costs nothing. pd does not tell when an array is written without being resized,
+ * a copy stays valid until @a sample_buffer_outdate marks it. A buffer that reads the array in place only has to point to the same words <br>
+ * @param b the buffer, may be NULL <br>
+ * @param name name of the array <br>
+ * @param soundfile words of the pd array <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param storage storage the buffer should have <br>
+ * @param format format a copy should be stored in <br>
+ * @return true if @a b can be kept <br>
+ */
+bool sample_buffer_matches(const sample_buffer *b, t_symbol *name, const t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format)
+{
+    return b && soundfile && !b->outdated && b->name == name && b->words == soundfile && b->length == soundfile_length && b->requested_storage == storage &&
+           b->requested_format == format;
+}
+/**
+ * @brief checks whether a buffer holds a soundfile on disk
+ * @param b the buffer <br>
+ * @param path path of the file <br>
+ * @param channel channel of the file that is played <br>
+ * @param storage storage the buffer should have <br>
+ * @param version version of the file on disk <br>
+ * @param cache_bytes size of the block cache of a streamed file <br>
+ * @param owner synth a streamed file belongs to <br>
+ * @param format format a copy should be stored in <br>
+ * @return true if @a b can be kept <br>
+ */
+static bool sample_buffer_matches_file(const sample_buffer *b, t_symbol *path, int channel, enum soundfile_storage storage, int64_t version, size_t cache_bytes, const void *owner,
+                                       enum sample_format format)
+{
+    return !b->words && b->name == path && b->channel == channel && b->requested_storage == storage && b->version == version &&
+           b->cache_bytes == cache_bytes && b->owner == owner && b->requested_format == format;
+}
+/**
+ * @brief adds a buffer to the cache
+ * @details the cache mutex has to be locked <br>
+ * @param b the buffer, may be NULL <br>
+ */
+static void sample_buffer_insert(sample_buffer *b)
+{
+    if(b)
+    {
+        b->next = sample_buffer_cache;
+        sample_buffer_cache = b;
+    }
+}
+/**
+ * @brief looks up the buffer of a pd array
+ * @details the cache mutex has to be locked. Takes a reference to the buffer that is found <br>
+ * @param name name of the array <br>
+ * @param soundfile words of the pd array <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param storage storage the buffer should have <br>
+ * @param format format a copy should be stored in <br>
+ * @return sample_buffer*, NULL if the array is not cached <br>
+ */
+static sample_buffer *sample_buffer_find(t_symbol *name, const t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format)
+{
+    sample_buffer *b;
+
+    for(b = sample_buffer_cache; b; b = b->next)
+    {
+        if(sample_buffer_matches(b, name, soundfile, soundfile_length, storage, format))
+        {
+            b->refcount++;
+            break;
+        }
+    }
+    return b;
+}
+/**
+ * @brief gets the buffer of a pd array if nothing has to be copied
+ * @details hands out the cached buffer of the array if it was not reloaded since, or makes a buffer that reads the array in place.
+ * Cheap enough for the thread of pd, no sample is read <br>
+ * @param name name of the array <br>
+ * @param soundfile words of the pd array <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param storage whether the soundfile is copied or read in place <br>
+ * @param format format a copy is stored in <br>
+ * @return sample_buffer* to be handed back with @a sample_buffer_release, NULL if the array has to be copied by @a sample_buffer_acquire_copy <br>
+ */
+sample_buffer *sample_buffer_acquire_cached(t_symbol *name, t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format)
+{
+    sample_buffer *b;
+
+    pthread_mutex_lock(&sample_buffer_cache_mutex);
+    b = sample_buffer_find(name, soundfile, soundfile_length, storage, format);
+    if(!b && sample_buffer_is_view(storage)) sample_buffer_insert(b = sample_buffer_new(name, soundfile, NULL, soundfile_length, storage, format));
+    pthread_mutex_unlock(&sample_buffer_cache_mutex);
+    return b;
+}
+/**
+ * @brief makes a copy of a pd array and adds it to the cache
+ * @details the table and the pyramid are built without holding the cache, so a worker thread can build them while pd looks up other buffers.
+ * The cache is searched again in the same critical section the copy is added in, a synth that copied the array in the meantime hands out its buffer and this copy is freed.
+ * A copy of samples taken before an array was reloaded is kept out of the cache <br>
+ * @param name name of the array <br>
+ * @param soundfile words of the pd array, only compared once the copy is made <br>
+ * @param samples samples of the array taken while pd could not change it, NULL to copy @a soundfile <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param storage storage the buffer is asked for <br>
+ * @param format format the copy is stored in <br>
+ * @param stamp @a sample_buffer_stamp when the samples were taken <br>
+ * @return sample_buffer* to be handed back with @a sample_buffer_release, NULL if the memory could not be allocated <br>
+ */
+sample_buffer *sample_buffer_acquire_copy(t_symbol *name, t_word *soundfile, const float *samples, int soundfile_length, enum soundfile_storage storage,
+                                          enum sample_format format, unsigned stamp)
+{
+    sample_buffer *b = sample_buffer_new(name, soundfile, samples, soundfile_length, storage, format), *cached = NULL;
+
+    if(!b) return NULL;
+    pthread_mutex_lock(&sample_buffer_cache_mutex);
+    b->outdated = stamp != sample_buffer_cache_stamp;
+    if(!b->outdated && (cached = sample_buffer_find(name, soundfile, soundfile_length, storage, format)))
+    {
+        sample_buffer_free(b);
+        b = cached;
+    }
+    else
+    {
+        sample_buffer_insert(b);
+    }
+    pthread_mutex_unlock(&sample_buffer_cache_mutex);
+    return b;
+}
+/**
+ * @brief gets the buffer of a pd array
+ * @details hands out the cached buffer of the array if it was not reloaded since, otherwise makes a new one and adds it to the cache.
+ * Buffers of earlier content of the array stay cached as long as other synths still read them <br>
+ * @param name name of the array <br>
+ * @param soundfile words of the pd array <br>
+ * @param soundfile_length length of the soundfile in samples <br>
+ * @param storage whether the soundfile is copied or read in place <br>
+ * @param format format a copy is stored in <br>
+ * @return sample_buffer* to be handed back with @a sample_buffer_release, NULL if the memory could not be allocated <br>
+ */
+sample_buffer *sample_buffer_acquire(t_symbol *name, t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format)
+{
+    sample_buffer *b = sample_buffer_acquire_cached(name, soundfile, soundfile_length, storage, format);
+    return b ? b : sample_buffer_acquire_copy(name, soundfile, NULL, soundfile_length, storage, format, sample_buffer_stamp());
+}
+/**
+ * @brief gets the buffer of a mapped soundfile
+ * @details hands out the cached buffer of the file as long as the file was not written since, otherwise maps the file and adds its buffer to the cache.
+ * The file is converted without holding the cache, other threads find their buffers in the meantime <br>
+ * @param path path of the WAV or AIFF file <br>
+ * @param channel channel of the file that is played <br>
+ * @param storage whether the soundfile is copied, read in place or streamed <br>
+ * @param cache_bytes size of the block cache of a streamed file <br>
+ * @param owner synth a streamed file belongs to, NULL otherwise <br>
+ * @param format format a copy is stored in <br>
+ * @return sample_buffer* to be handed back with @a sample_buffer_release, NULL if the file cannot be played <br>
+ */
+static sample_buffer *sample_buffer_acquire_mapped(t_symbol *path, int channel, enum soundfile_storage storage, size_t cache_bytes, const void *owner,
+                                                   enum sample_format format)
+{
+    int64_t version = mapped_soundfile_version(path->s_name);
+    sample_buffer *b;
+
+    if(version < 0) return NULL;
+    if(channel < 0) channel = 0;
+    pthread_mutex_lock(&sample_buffer_cache_mutex);
+    for(b = sample_buffer_cache; b; b = b->next)
+    {
+        if(sample_buffer_matches_file(b, path, channel, storage, version, cache_bytes, owner, format))
+        {
+            b->refcount++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sample_buffer_cache_mutex);
+    if(!b && (b = sample_buffer_new_file(path, channel, storage, version, cache_bytes, format)))
+    {
+        b->owner = owner;
+        pthread_mutex_lock(&sample_buffer_cache_mutex);
+        sample_buffer_insert(b);
+        pthread_mutex_unlock(&sample_buffer_cache_mutex);
+    }
+    return b;
+}
+/**
+ * @brief gets the buffer of a soundfile on disk
+ * @details hands out the cached buffer of the file as long as the file was not written since, otherwise maps the file and adds its buffer to the cache <br>
+ * @param path path of the WAV or AIFF file <br>
+ * @param channel channel of the file that is played, later channels than the file has play its last channel <br>
+ * @param storage whether the soundfile is copied or read in place from the mapping <br>
+ * @param format format a copy is stored in <br>
+ * @return sample_buffer* to be handed back with @a sample_buffer_release, NULL if the file cannot be played <br>
+ */
+sample_buffer *sample_buffer_acquire_file(t_symbol *path, int channel, enum soundfile_storage storage, enum sample_format format)
+{
+    if(storage == STORAGE_STREAM) storage = STORAGE_COPY;
+    return sample_buffer_acquire_mapped(path, channel, storage, 0, NULL, format);
+}
+/**
+ * @brief gets a stream of a soundfile on disk
+ * @details a stream follows the region one synth reads, so every synth gets a stream of its own. The synth gets its stream back as long as the file and the cache size stay the same <br>
+ * @param path path of the WAV or AIFF file <br>
+ * @param channel channel of the file that is played, later channels than the file has play its last channel <br>
+ * @param cache_bytes size of the block cache, the memory of the stream does not depend on the length of the file <br>
+ * @param owner synth the stream belongs to <br>
+ * @return sample_buffer* to be handed back with @a sample_buffer_release, NULL if the file cannot be played <br>
+ */
+sample_buffer *sample_buffer_acquire_stream(t_symbol *path, int channel, size_t cache_bytes, const void *owner)
+{
+    return sample_buffer_acquire_mapped(path, channel, STORAGE_STREAM, cache_bytes, owner, SAMPLE_FLOAT32);
+}
+/**
+ * @brief hands back a buffer
+ * @details the last synth that releases a buffer frees it <br>
+ * @param b the buffer, may be NULL <br>
+ */
+void sample_buffer_release(sample_buffer *b)
+{
+    sample_buffer **link;
+
+    if(!b) return;
+    pthread_mutex_lock(&sample_buffer_cache_mutex);
+    if(--b->refcount == 0)
+    {
+        for(link = &sample_buffer_cache; *link; link = &(*link)->next)
+        {
+            if(*link == b)
+            {
+                *link = b->next;
+                break;
+            }
+        }
+        sample_buffer_free(b);
+    }
+    pthread_mutex_unlock(&sample_buffer_cache_mutex);
+}
+/**
+ * @brief gets the number of times an array was reloaded
+ * @details taken together with the samples of an array and handed to @a sample_buffer_acquire_copy <br>
+ * @return unsigned stamp of the cache <br>
+ */
+unsigned sample_buffer_stamp(void)
+{
+    unsigned stamp;
+
+    pthread_mutex_lock(&sample_buffer_cache_mutex);
+    stamp = sample_buffer_cache_stamp;
+    pthread_mutex_unlock(&sample_buffer_cache_mutex);
+    return stamp;
+}
+/**
+ * @brief marks the copies of a pd array as outdated
+ * @details called after the array was written, copies of it are no longer handed out and the next synth that loads the array copies it again.
+ * Synths keep playing the copies they hold, buffers that read the array in place always play its current samples <br>
+ * @param name name of the array <br>
+ */
+void sample_buffer_outdate(t_symbol *name)
+{
+    pthread_mutex_lock(&sample_buffer_cache_mutex);
+    sample_buffer_cache_stamp++;
+    for(sample_buffer *b = sample_buffer_cache; b; b = b->next)
+    {
+        if(b->words && b->name == name && b->storage != STORAGE_VIEW) b->outdated = true;
+    }
+    pthread_mutex_unlock(&sample_buffer_cache_mutex);
+}
+/**
+ * @brief reads one sample of the buffer
+ * @details reads the level of the pyramid that matches @a rate <br>
+ * @param b the buffer <br>
+ * @param position read position, wrapped into the buffer <br>
+ * @param rate absolute speed the position advances with <br>
+ * @param interpolation interpolation between the samples of the soundfile <br>
+ * @return float interpolated sample <br>
+ */
+float sample_buffer_read(sample_buffer *b, fixed_position position, float rate, enum interpolation interpolation)
+{
+    int level;
+
+    if(b->stream) return sample_stream_read(b->stream, position, interpolation);
+    if(b->length < 2) return b->pyramid.levels[0][0];
+
+    position = fixed_wrap(position, b->pyramid.wraps[0]);
+    if(b->storage == STORAGE_VIEW)
+    {
+        return grain_kernel_read_strided(b->pyramid.levels[0], b->stride, b->length - 1, fixed_index(position), fixed_frac(position), interpolation);
+    }
+    level = mipmap_level(&b->pyramid, rate);
+    position >>= level;
+    if(b->pyramid.format != SAMPLE_FLOAT32)
+    {
+        return grain_kernel_read_compact(b->pyramid.compact_levels[level], b->pyramid.format, fixed_index(position), fixed_frac(position), interpolation);
+    }
+    return grain_kernel_read(b->pyramid.levels[level], fixed_index(position), fixed_frac(position), interpolation);
+}
+/**
+ * @brief points a span at the buffer
+ * @details sets the soundfile, its format, stride, wrap, position and step of @a s for the level of the pyramid that matches @a rate, backwards spans at the original speed read the reversed copy forwards <br>
+ * @param b the buffer <br>
+ * @param s the span <br>
+ * @param position read position of the first sample of the span in the soundfile <br>
+ * @param step advance of the read position per sample in the soundfile <br>
+ * @param rate absolute speed the position advances with <br>
+ */
+void sample_buffer_span(sample_buffer *b, grain_span *s, fixed_position position, fixed_position step, float rate)
+{
+    int level = mipmap_level(&b->pyramid, rate);
+
+    s->soundfile = b->pyramid.levels[level];
+    s->compact = b->pyramid.compact_levels[level];
+    s->format = b->pyramid.format;
+    s->stride = b->stride;
+    s->wrap = b->pyramid.wraps[level];
+    s->position = position >> level;
+    s->step = step / (1 << level);
+    if(s->step < 0 && level == 0 && (b->pyramid.reversed || b->pyramid.compact_reversed))
+    {
+        // position 0 of the loop is the last sample of the reversed copy, one fixed point step before the wrap
+        s->soundfile = b->pyramid.reversed;
+        s->compact = b->pyramid.compact_reversed;
+        s->position = s->wrap - 1 - fixed_wrap(s->position, s->wrap);
+        s->step = -s->step;
+    }
+}
+/**
+ * @brief publishes the region the grains are going to read
+ * @details only streamed buffers load the region, all other buffers hold the whole soundfile <br>
+ * @param b the buffer <br>
+ * @param first_frame first frame that may be read, may lie before the soundfile <br>
+ * @param last_frame last frame that may be read, may lie behind the soundfile <br>
+ * @param start_frame frame the grains start at <br>
+ */
+void sample_buffer_prefetch(sample_buffer *b, int first_frame, int last_frame, int start_frame)
+{
+    if(b->stream) sample_stream_prefetch(b->stream, first_frame, last_frame, start_frame);
+}
+/**
+ * @brief marks the start of a dsp block reading the buffer
+ * @param b the buffer, may be NULL <br>
+ */
+void sample_buffer_begin_read(sample_buffer *b)
+{
+    if(b && b->stream) sample_stream_begin_read(b->stream);
+}
+/**
+ * @brief marks the end of a dsp block reading the buffer
+ * @param b the buffer, may be NULL <br>
+ */
+void sample_buffer_end_read(sample_buffer *b)
+{
+    if(b && b->stream) sample_stream_end_read(b->stream);
+}
+/**
+ * @brief number of samples a grain can read from the buffer
+ * @param b the buffer <br>
+ * @param position read position of the first sample <br>
+ * @param step advance of the read position per sample <br>
+ * @param num_samples number of samples to check <br>
+ * @return int @a num_samples, less for a streamed buffer if the grain reaches a block that is not loaded <br>
+ */
+int sample_buffer_available(sample_buffer *b, fixed_position position, fixed_position step, int num_samples)
+{
+    return b->stream ? sample_stream_available(b->stream, position, step, num_samples) : num_samples;
+}
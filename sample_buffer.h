@@ -0,0 +1,88 @@
+/**
+ * @file sample_buffer.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a sample_buffer.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef sample_buffer_h
+#define sample_buffer_h
+
+#include "m_pd.h"
+#include "purple_utils.h"
+#include "mipmap.h"
+#include "grain_kernels.h"
+#include "mapped_soundfile.h"
+#include "sample_stream.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief storage of the soundfile
+ */
+enum soundfile_storage {
+    STORAGE_COPY,                               ///< the soundfile is copied into a table with guard samples, band limited levels and a reversed copy <br>
+    STORAGE_VIEW,                               ///< the soundfile is read in place from the words of the pd array or the mapping of the file, nothing is copied and no band limited levels are built <br>
+    STORAGE_STREAM                              ///< a file is decoded block by block around the region the grains read into a cache of fixed size, a pd array is copied <br>
+};
+
+/**
+ * @struct sample_buffer
+ * @brief the soundfile as the grains read it
+ * @details owns the soundfile table and its pyramid in an arena of its own, so the synth can swap it for another buffer without rebuilding anything else.
+ * Buffers are shared by all synths that read the same array and are never changed once they are made <br>
+ */
+typedef struct sample_buffer
+{
+    purple_arena arena;                         ///< holds @a table and the levels of @a pyramid <br>
+    t_symbol    *name;                          ///< name of the array or path of the file the buffer was made from <br>
+    const t_word *words;                        ///< array the buffer was made from, NULL for a file <br>
+    mapped_soundfile file;                      ///< mapping of the file the buffer reads in place, unmapped once a file is copied <br>
+    int64_t     version;                        ///< version of the file on disk when it was mapped <br>
+    sample_stream *stream;                      ///< block cache of a streamed file, NULL if the soundfile is held entirely <br>
+    size_t      cache_bytes;                    ///< size of the block cache of @a stream <br>
+    const void  *owner;                         ///< synth a streamed buffer belongs to, streams follow the region of one synth and are not shared <br>
+    float       *table;                         ///< copy of the soundfile with @a MIPMAP_GUARD guard samples on both sides, NULL if the soundfile is read in place or stored in 16 bits <br>
+    mipmap      pyramid;                        ///< band limited copies of @a table for grains that read faster than the original speed, holds the format the copy is stored in <br>
+    enum soundfile_storage storage,             ///< whether the soundfile is copied or read in place <br>
+                requested_storage;              ///< storage the buffer was asked for, a soundfile that cannot be read in place is copied <br>
+    enum sample_format requested_format;        ///< format a copy was asked to be stored in, views and streams are always float <br>
+    int         length,                         ///< length of the soundfile in samples <br>
+                channel,                        ///< channel of the file that is played <br>
+                stride,                         ///< distance between two samples of level 0 of @a pyramid in floats, 1 for @a table <br>
+                refcount;                       ///< number of synths using the buffer <br>
+    bool        outdated;                       ///< the array was written since its samples were taken, the buffer is no longer handed out <br>
+    struct sample_buffer *next;                 ///< next buffer of the cache <br>
+} sample_buffer;
+
+sample_buffer *sample_buffer_acquire(t_symbol *name, t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format);
+sample_buffer *sample_buffer_acquire_cached(t_symbol *name, t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format);
+sample_buffer *sample_buffer_acquire_copy(t_symbol *name, t_word *soundfile, const float *samples, int soundfile_length, enum soundfile_storage storage,
+                                          enum sample_format format, unsigned stamp);
+sample_buffer *sample_buffer_acquire_file(t_symbol *path, int channel, enum soundfile_storage storage, enum sample_format format);
+sample_buffer *sample_buffer_acquire_stream(t_symbol *path, int channel, size_t cache_bytes, const void *owner);
+void sample_buffer_release(sample_buffer *b);
+unsigned sample_buffer_stamp(void);
+void sample_buffer_outdate(t_symbol *name);
+bool sample_buffer_matches(const sample_buffer *b, t_symbol *name, const t_word *soundfile, int soundfile_length, enum soundfile_storage storage, enum sample_format format);
+float sample_buffer_read(sample_buffer *b, fixed_position position, float rate, enum interpolation interpolation);
+void sample_buffer_span(sample_buffer *b, grain_span *s, fixed_position position, fixed_position step, float rate);
+void sample_buffer_prefetch(sample_buffer *b, int first_frame, int last_frame, int start_frame);
+void sample_buffer_begin_read(sample_buffer *b);
+void sample_buffer_end_read(sample_buffer *b);
+int sample_buffer_available(sample_buffer *b, fixed_position position, fixed_position step, int num_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
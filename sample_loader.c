@@ -0,0 +1,191 @@
+/**
+ * @file sample_loader.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief makes sample buffers in the background
+ * @details copies arrays, converts files and builds their pyramids on a worker thread. pd keeps playing the previous buffer until the new one is handed over <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <stdlib.h>
+#include "sample_loader.h"
+
+/**
+ * @brief makes the buffer of a request
+ * @param r the request <br>
+ * @return sample_buffer*, NULL if the file cannot be played or the memory could not be allocated <br>
+ */
+static sample_buffer *sample_loader_load(const sample_load_request *r)
+{
+    if(r->words)
+    {
+        return sample_buffer_acquire_copy(r->name, r->words, r->samples, r->length, r->storage, r->format, r->stamp);
+    }
+    if(r->storage == STORAGE_STREAM)
+    {
+        return sample_buffer_acquire_stream(r->name, r->channel, r->cache_bytes, r->owner);
+    }
+    return sample_buffer_acquire_file(r->name, r->channel, r->storage, r->format);
+}
+/**
+ * @brief drops the waiting request and the result that was not taken
+ * @details the loader mutex has to be locked <br>
+ * @param l the loader <br>
+ */
+static void sample_loader_clear(sample_loader *l)
+{
+    if(l->has_request) free(l->request.samples);
+    if(l->has_result) sample_buffer_release(l->result);
+    l->has_request = false;
+    l->has_result = false;
+    l->result = NULL;
+}
+/**
+ * @brief hands a buffer to pd
+ * @details a buffer of a request that was overtaken in the meantime is released <br>
+ * @param l the loader <br>
+ * @param b the buffer, NULL if it could not be made <br>
+ * @param generation number of the request the buffer was made for <br>
+ */
+static void sample_loader_finish(sample_loader *l, sample_buffer *b, unsigned generation)
+{
+    pthread_mutex_lock(&l->mutex);
+    l->loading = false;
+    if(generation == l->generation)
+    {
+        l->result = b;
+        l->has_result = true;
+        b = NULL;
+    }
+    pthread_mutex_unlock(&l->mutex);
+    sample_buffer_release(b);
+}
+/**
+ * @brief job of the worker thread
+ * @details takes the waiting request and makes its buffer without holding the loader, so pd can make a newer request in the meantime <br>
+ * @param owner pointer to the loader <br>
+ */
+static void sample_loader_job(void *owner)
+{
+    sample_loader *l = (sample_loader *)owner;
+    sample_load_request r;
+    unsigned generation;
+
+    pthread_mutex_lock(&l->mutex);
+    if(!l->has_request)
+    {
+        pthread_mutex_unlock(&l->mutex);
+        return;
+    }
+    r = l->request;
+    generation = l->generation;
+    l->has_request = false;
+    l->loading = true;
+    pthread_mutex_unlock(&l->mutex);
+
+    sample_loader_finish(l, sample_loader_load(&r), generation);
+    free(r.samples);
+}
+/**
+ * @brief starts the worker thread of a loader
+ * @details without the thread the requests are made right away <br>
+ * @param l the loader <br>
+ */
+void sample_loader_start(sample_loader *l)
+{
+    pthread_mutex_init(&l->mutex, NULL);
+    l->has_request = false;
+    l->loading = false;
+    l->has_result = false;
+    l->result = NULL;
+    l->generation = 0;
+    purple_worker_start(&l->worker, sample_loader_job, l);
+}
+/**
+ * @brief stops the worker thread of a loader
+ * @details waits for a buffer being made and releases it <br>
+ * @param l the loader <br>
+ */
+void sample_loader_stop(sample_loader *l)
+{
+    purple_worker_stop(&l->worker);
+    pthread_mutex_lock(&l->mutex);
+    sample_loader_clear(l);
+    pthread_mutex_unlock(&l->mutex);
+    pthread_mutex_destroy(&l->mutex);
+}
+/**
+ * @brief asks the loader for a buffer
+ * @details replaces the request that is waiting and drops the result that was not taken yet, a buffer the worker is making right now is released once it is done <br>
+ * @param l the loader <br>
+ * @param r the request, the loader takes over its samples <br>
+ */
+void sample_loader_request(sample_loader *l, const sample_load_request *r)
+{
+    pthread_mutex_lock(&l->mutex);
+    sample_loader_clear(l);
+    l->generation++;
+    l->request = *r;
+    l->has_request = true;
+    pthread_mutex_unlock(&l->mutex);
+
+    if(l->worker.running)
+    {
+        purple_worker_wake(&l->worker);
+    }
+    else
+    {
+        sample_loader_job(l);
+    }
+}
+/**
+ * @brief drops all requests
+ * @details called when pd got its buffer without the loader, so an earlier request does not replace it later <br>
+ * @param l the loader <br>
+ */
+void sample_loader_cancel(sample_loader *l)
+{
+    pthread_mutex_lock(&l->mutex);
+    sample_loader_clear(l);
+    l->generation++;
+    pthread_mutex_unlock(&l->mutex);
+}
+/**
+ * @brief checks whether the latest request is still being worked on
+ * @param l the loader <br>
+ * @return true until its buffer was taken by @a sample_loader_poll <br>
+ */
+bool sample_loader_busy(sample_loader *l)
+{
+    bool busy;
+
+    pthread_mutex_lock(&l->mutex);
+    busy = l->has_request || l->loading || l->has_result;
+    pthread_mutex_unlock(&l->mutex);
+    return busy;
+}
+/**
+ * @brief takes the buffer of the latest request
+ * @param l the loader <br>
+ * @param b the buffer, to be handed back with @a sample_buffer_release, NULL if it could not be made <br>
+ * @return true if the latest request is done <br>
+ */
+bool sample_loader_poll(sample_loader *l, sample_buffer **b)
+{
+    bool done;
+
+    pthread_mutex_lock(&l->mutex);
+    done = l->has_result;
+    *b = l->result;
+    l->has_result = false;
+    l->result = NULL;
+    pthread_mutex_unlock(&l->mutex);
+    return done;
+}
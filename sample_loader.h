@@ -0,0 +1,73 @@
+/**
+ * @file sample_loader.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a sample_loader.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef sample_loader_h
+#define sample_loader_h
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "m_pd.h"
+#include "purple_worker.h"
+#include "sample_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @struct sample_load_request
+ * @brief a sample buffer to be made by the loader
+ */
+typedef struct sample_load_request
+{
+    t_symbol    *name;                          ///< name of the array or path of the file <br>
+    t_word      *words;                         ///< words of the array, NULL for a file <br>
+    float       *samples;                       ///< samples of the array taken by pd, allocated with malloc and owned by the request <br>
+    int         length,                         ///< length of the array in samples <br>
+                channel;                        ///< channel of the file that is played <br>
+    enum soundfile_storage storage;             ///< storage the buffer is asked for <br>
+    enum sample_format format;                  ///< format a copy is stored in <br>
+    size_t      cache_bytes;                    ///< size of the block cache of a streamed file <br>
+    unsigned    stamp;                          ///< @a sample_buffer_stamp when the samples of the array were taken <br>
+    const void  *owner;                         ///< synth a streamed file belongs to <br>
+} sample_load_request;
+
+/**
+ * @struct sample_loader
+ * @brief makes sample buffers on a worker thread
+ * @details pd hands a request to the loader and polls for the buffer, so copying, converting and building the pyramid never hold up the thread that runs the dsp.
+ * Only the latest request counts, a request that is overtaken by a newer one is dropped or its buffer released <br>
+ */
+typedef struct sample_loader
+{
+    purple_worker worker;                       ///< thread making the buffers <br>
+    pthread_mutex_t mutex;                      ///< guards all following members <br>
+    sample_load_request request;                ///< request waiting for the worker <br>
+    bool        has_request,                    ///< @a request is waiting <br>
+                loading,                        ///< the worker is making a buffer <br>
+                has_result;                     ///< @a result belongs to the latest request and was not taken yet <br>
+    sample_buffer *result;                      ///< buffer of the latest request, NULL if it could not be made <br>
+    unsigned    generation;                     ///< number of the latest request, requests made before it are stale <br>
+} sample_loader;
+
+void sample_loader_start(sample_loader *l);
+void sample_loader_stop(sample_loader *l);
+void sample_loader_request(sample_loader *l, const sample_load_request *r);
+void sample_loader_cancel(sample_loader *l);
+bool sample_loader_busy(sample_loader *l);
+bool sample_loader_poll(sample_loader *l, sample_buffer **b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
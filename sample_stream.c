@@ -0,0 +1,367 @@
+/**
+ * @file sample_stream.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief soundfiles streamed from disk
+ * @details a reader thread decodes the blocks of a mapped soundfile around the region the grains read into a block cache of fixed size, so the memory does not depend on the length of the file.
+ * The dsp routine never waits for the reader, a block that is not loaded yet is reported as missing and the grains reading it fade out <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include <time.h>
+#include "sample_stream.h"
+
+#define STREAM_BLOCK_SIZE (STREAM_BLOCK_FRAMES + 2 * STREAM_GUARD)    ///< floats of a block with its guard samples <br>
+
+/**
+ * @brief number of slots of a block cache
+ * @param num_blocks number of blocks of the soundfile <br>
+ * @param cache_bytes size of the cache in bytes <br>
+ * @return int number of slots, a multiple of @a STREAM_WAYS, at least one set and no more sets than the soundfile needs <br>
+ */
+static int sample_stream_num_slots(int num_blocks, size_t cache_bytes)
+{
+    size_t num_sets = cache_bytes / (STREAM_WAYS * STREAM_BLOCK_SIZE * sizeof(float));
+    size_t max_sets = (num_blocks + STREAM_WAYS - 2) / (STREAM_WAYS - 1);
+    if(num_sets > max_sets) num_sets = max_sets;
+    if(num_sets < 1) num_sets = 1;
+    return (int)num_sets * STREAM_WAYS;
+}
+/**
+ * @brief number of blocks of a soundfile
+ * @param length length of the soundfile in samples, at least 2 <br>
+ * @return int blocks covering the loop of the soundfile <br>
+ */
+static int sample_stream_num_blocks(int length)
+{
+    return (length - 1 + STREAM_BLOCK_FRAMES - 1) / STREAM_BLOCK_FRAMES;
+}
+/**
+ * @brief arena memory of a stream
+ * @param length length of the soundfile in samples, at least 2 <br>
+ * @param cache_bytes size of the block cache in bytes <br>
+ * @return size_t bytes to reserve for @a sample_stream_new <br>
+ */
+size_t sample_stream_arena_size(int length, size_t cache_bytes)
+{
+    int num_slots = sample_stream_num_slots(sample_stream_num_blocks(length), cache_bytes);
+    return purple_arena_aligned_size(sizeof(sample_stream)) +
+           purple_arena_aligned_size(num_slots * sizeof(stream_block)) +
+           num_slots * purple_arena_aligned_size(STREAM_BLOCK_SIZE * sizeof(float));
+}
+/**
+ * @brief finds the slot of a block
+ * @details the loads pair with the eviction in @a sample_stream_load <br>
+ * @param st the stream <br>
+ * @param block block of the soundfile <br>
+ * @return stream_block* slot holding the block, NULL if it is not loaded <br>
+ */
+static inline stream_block *sample_stream_find(sample_stream *st, int block)
+{
+    stream_block *slot = &st->slots[(block % st->num_sets) * STREAM_WAYS];
+    for(int way = 0; way < STREAM_WAYS; way++, slot++)
+    {
+        if(atomic_load(&slot->index) == block) return slot;
+    }
+    return NULL;
+}
+/**
+ * @brief finds a block in the cache for the dsp routine
+ * @details a block found here stays in its slot until @a sample_stream_end_read <br>
+ * @param st the stream <br>
+ * @param block block of the soundfile <br>
+ * @return const float* first sample of the block, NULL if it is not loaded <br>
+ */
+static inline const float *sample_stream_block(sample_stream *st, int block)
+{
+    stream_block *slot = sample_stream_find(st, block);
+    if(!slot) return NULL;
+    atomic_store_explicit(&slot->last_read, atomic_load_explicit(&st->reading, memory_order_relaxed), memory_order_relaxed);
+    return slot->samples;
+}
+/**
+ * @brief picks the slot a block is loaded into
+ * @details an empty slot of the set of the block, otherwise the slot whose block was read the longest time ago, blocks of the window are kept <br>
+ * @param st the stream <br>
+ * @param block block of the soundfile <br>
+ * @param first first block of the window <br>
+ * @param count number of blocks of the window <br>
+ * @return stream_block* the slot, NULL if every slot of the set holds a block of the window <br>
+ */
+static stream_block *sample_stream_victim(sample_stream *st, int block, int first, int count)
+{
+    stream_block *slot = &st->slots[(block % st->num_sets) * STREAM_WAYS];
+    stream_block *victim = NULL;
+    unsigned int now = atomic_load_explicit(&st->reading, memory_order_relaxed);
+    unsigned int oldest = 0;
+
+    for(int way = 0; way < STREAM_WAYS; way++, slot++)
+    {
+        int index = atomic_load_explicit(&slot->index, memory_order_relaxed);
+        unsigned int age;
+
+        if(index < 0) return slot;
+        if((index - first + st->num_blocks) % st->num_blocks < count) continue;
+        age = now - atomic_load_explicit(&slot->last_read, memory_order_relaxed);
+        if(!victim || age >= oldest)
+        {
+            victim = slot;
+            oldest = age;
+        }
+    }
+    return victim;
+}
+/**
+ * @brief number of samples a span reads from one block
+ * @param block block of the read position <br>
+ * @param position read position in the range of 0 - wrap <br>
+ * @param step advance of the read position per sample <br>
+ * @param wrap read positions wrap around at this value <br>
+ * @param remaining number of samples left in the span <br>
+ * @return int samples until the read position leaves the block, at most @a remaining <br>
+ */
+static inline int sample_stream_block_samples(int block, fixed_position position, fixed_position step, fixed_position wrap, int remaining)
+{
+    fixed_position start = (fixed_position)block * STREAM_BLOCK_FRAMES << FIXED_FRACTION_BITS;
+    fixed_position end = (fixed_position)(block + 1) * STREAM_BLOCK_FRAMES << FIXED_FRACTION_BITS;
+    fixed_position n;
+
+    if(end > wrap) end = wrap;
+    if(step > 0) n = (end - 1 - position) / step + 1;
+    else if(step < 0) n = (position - start) / -step + 1;
+    else return remaining;
+    return (n < remaining) ? (int)n : remaining;
+}
+/**
+ * @brief decodes a block into a slot
+ * @details the slot is marked empty first. If a dsp block is reading the cache at that moment the reader waits until it ended, it may still read the previous block of the slot.
+ * Sample n outside of the soundfile holds the sample n is wrapped to, like the guard samples of a table. The pages of the file are dropped again once the block is decoded <br>
+ * @param st the stream <br>
+ * @param slot the slot <br>
+ * @param block block of the soundfile <br>
+ */
+static void sample_stream_load(sample_stream *st, stream_block *slot, int block)
+{
+    const int wrap_index = st->length - 1;
+    const int first = block * STREAM_BLOCK_FRAMES;
+    unsigned int reading;
+    struct timespec pause = {0, 1000000L};
+
+    atomic_store(&slot->index, -1);
+    reading = atomic_load(&st->reading);
+    while((reading & 1) && atomic_load(&st->reading) == reading)
+    {
+        if(atomic_load(&st->worker.quit)) return;
+        nanosleep(&pause, NULL);
+    }
+
+    for(int j = -STREAM_GUARD; j < STREAM_BLOCK_FRAMES + STREAM_GUARD; j++)
+    {
+        int index = first + j;
+        while(index < 0) index += wrap_index;
+        while(index > wrap_index) index -= wrap_index;
+        slot->samples[j] = mapped_soundfile_sample(st->file, index, st->channel);
+    }
+    atomic_store_explicit(&slot->index, block, memory_order_release);
+    mapped_soundfile_evict(st->file, first, STREAM_BLOCK_FRAMES);
+}
+/**
+ * @brief job of the reader thread
+ * @details loads the blocks of the window from its first block on, the window is read again for every block, so a moving window is followed right away <br>
+ * @param owner pointer to the @a sample_stream <br>
+ */
+static void sample_stream_job(void *owner)
+{
+    sample_stream *st = (sample_stream *)owner;
+
+    for(int k = 0; !atomic_load(&st->worker.quit); k++)
+    {
+        long long window = atomic_load(&st->window);
+        int first = (int)(window >> 32);
+        int count = (int)(window & 0xffffffff);
+        int block = (first + k) % st->num_blocks;
+        stream_block *slot;
+
+        if(k >= count) break;
+        if(!sample_stream_find(st, block) && (slot = sample_stream_victim(st, block, first, count))) sample_stream_load(st, slot, block);
+    }
+}
+/**
+ * @brief makes a stream of a mapped soundfile
+ * @details reserves the block cache in @a arena and starts the reader thread, no block is loaded before the first @a sample_stream_prefetch <br>
+ * @param arena arena reserved with @a sample_stream_arena_size <br>
+ * @param file the mapped soundfile with at least 2 sample frames, has to outlive the stream <br>
+ * @param channel channel of the file that is played <br>
+ * @param cache_bytes size of the block cache in bytes <br>
+ * @return sample_stream*, NULL if the reader thread could not be started <br>
+ */
+sample_stream *sample_stream_new(purple_arena *arena, const mapped_soundfile *file, int channel, size_t cache_bytes)
+{
+    sample_stream *st = (sample_stream *)purple_arena_alloc(arena, sizeof(sample_stream));
+
+    st->file = file;
+    st->channel = channel;
+    st->length = file->num_frames;
+    st->wrap = (fixed_position)(st->length - 1) << FIXED_FRACTION_BITS;
+    st->num_blocks = sample_stream_num_blocks(st->length);
+    st->num_slots = sample_stream_num_slots(st->num_blocks, cache_bytes);
+    st->num_sets = st->num_slots / STREAM_WAYS;
+    st->slots = (stream_block *)purple_arena_alloc(arena, st->num_slots * sizeof(stream_block));
+    for(int i = 0; i < st->num_slots; i++)
+    {
+        atomic_init(&st->slots[i].index, -1);
+        atomic_init(&st->slots[i].last_read, 0);
+        st->slots[i].samples = (float *)purple_arena_alloc(arena, STREAM_BLOCK_SIZE * sizeof(float)) + STREAM_GUARD;
+    }
+    atomic_init(&st->window, 0);
+    atomic_init(&st->reading, 0);
+
+    if(!purple_worker_start(&st->worker, sample_stream_job, st))
+    {
+        purple_worker_stop(&st->worker);
+        return NULL;
+    }
+    return st;
+}
+/**
+ * @brief stops the reader thread of a stream
+ * @param st the stream, may be NULL <br>
+ */
+void sample_stream_stop(sample_stream *st)
+{
+    if(st) purple_worker_stop(&st->worker);
+}
+/**
+ * @brief publishes the region the grains are going to read
+ * @details called by the dsp routine once per block. The window covers the frames from @a first_frame to @a last_frame, wrapped around the loop of the soundfile, and is centered on @a start_frame if the cache is too small for it.
+ * The window takes up to @a STREAM_WAYS - 1 slots of every set, the remaining slots keep blocks of earlier windows that grains may still read.
+ * The reader thread is only woken when the window moved <br>
+ * @param st the stream <br>
+ * @param first_frame first frame that may be read, may lie before the soundfile <br>
+ * @param last_frame last frame that may be read, may lie behind the soundfile <br>
+ * @param start_frame frame the grains start at <br>
+ */
+void sample_stream_prefetch(sample_stream *st, int first_frame, int last_frame, int start_frame)
+{
+    const int wrap_index = st->length - 1;
+    int capacity = st->num_sets * (STREAM_WAYS - 1);
+    int count = (last_frame - first_frame) / STREAM_BLOCK_FRAMES + 2;
+    long long window;
+
+    if(capacity > st->num_blocks) capacity = st->num_blocks;
+    if(count >= capacity)
+    {
+        count = capacity;
+        first_frame = start_frame - (capacity / 2) * STREAM_BLOCK_FRAMES;
+    }
+    first_frame %= wrap_index;
+    if(first_frame < 0) first_frame += wrap_index;
+    window = ((long long)(first_frame / STREAM_BLOCK_FRAMES) << 32) | count;
+
+    if(atomic_load_explicit(&st->window, memory_order_relaxed) != window)
+    {
+        atomic_store(&st->window, window);
+        purple_worker_wake(&st->worker);
+    }
+}
+/**
+ * @brief marks the start of a dsp block reading the cache
+ * @param st the stream <br>
+ */
+void sample_stream_begin_read(sample_stream *st)
+{
+    atomic_fetch_add(&st->reading, 1);
+}
+/**
+ * @brief marks the end of a dsp block reading the cache
+ * @details blocks found during the dsp block may be overwritten from now on <br>
+ * @param st the stream <br>
+ */
+void sample_stream_end_read(sample_stream *st)
+{
+    atomic_fetch_add(&st->reading, 1);
+}
+/**
+ * @brief number of samples a grain can read before it reaches a block that is not loaded
+ * @param st the stream <br>
+ * @param position read position of the first sample <br>
+ * @param step advance of the read position per sample <br>
+ * @param num_samples number of samples to check <br>
+ * @return int number of samples that read loaded blocks, @a num_samples if all of them do <br>
+ */
+int sample_stream_available(sample_stream *st, fixed_position position, fixed_position step, int num_samples)
+{
+    int k = 0;
+
+    position = fixed_wrap(position, st->wrap);
+    while(k < num_samples)
+    {
+        int block = fixed_index(position) / STREAM_BLOCK_FRAMES;
+        int n;
+
+        if(!sample_stream_block(st, block)) return k;
+        n = sample_stream_block_samples(block, position, step, st->wrap, num_samples - k);
+        k += n;
+        position = fixed_wrap(position + n * step, st->wrap);
+    }
+    return num_samples;
+}
+/**
+ * @brief reads one sample of the stream
+ * @param st the stream <br>
+ * @param position read position, wrapped into the soundfile <br>
+ * @param interpolation interpolation between the samples of the soundfile <br>
+ * @return float interpolated sample, 0 if its block is not loaded <br>
+ */
+float sample_stream_read(sample_stream *st, fixed_position position, enum interpolation interpolation)
+{
+    int index, block;
+    const float *samples;
+
+    position = fixed_wrap(position, st->wrap);
+    index = fixed_index(position);
+    block = index / STREAM_BLOCK_FRAMES;
+    if(!(samples = sample_stream_block(st, block))) return 0;
+    return grain_kernel_read(samples, index - block * STREAM_BLOCK_FRAMES, fixed_frac(position), interpolation);
+}
+/**
+ * @brief renders a span from the stream
+ * @details splits the span where its read position moves to the next block and renders every part that reads a loaded block with @a kernel like a table with guard samples, the parts reading missing blocks stay silent <br>
+ * @param st the stream <br>
+ * @param s span with its position, step, length, output, gains and window set <br>
+ * @param kernel kernel rendering the parts <br>
+ */
+void sample_stream_render(sample_stream *st, const grain_span *s, grain_span_kernel kernel)
+{
+    grain_span part = *s;
+    fixed_position position = fixed_wrap(s->position, st->wrap);
+    int k = 0;
+
+    part.format = SAMPLE_FLOAT32;
+    part.stride = 1;
+    part.wrap = (fixed_position)STREAM_BLOCK_FRAMES << FIXED_FRACTION_BITS;
+    while(k < s->length)
+    {
+        int block = fixed_index(position) / STREAM_BLOCK_FRAMES;
+        int n = sample_stream_block_samples(block, position, s->step, st->wrap, s->length - k);
+
+        if((part.soundfile = sample_stream_block(st, block)))
+        {
+            part.length = n;
+            part.position = position - ((fixed_position)block * STREAM_BLOCK_FRAMES << FIXED_FRACTION_BITS);
+            part.out = s->out + k;
+            part.voice_gain = s->voice_gain + k;
+            part.window_phase = s->window_phase + k * s->window_increment;
+            kernel(&part);
+        }
+        k += n;
+        position = fixed_wrap(position + n * s->step, st->wrap);
+    }
+}
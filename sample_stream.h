@@ -0,0 +1,83 @@
+/**
+ * @file sample_stream.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a sample_stream.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef sample_stream_h
+#define sample_stream_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "purple_utils.h"
+#include "purple_worker.h"
+#include "grain_kernels.h"
+#include "mapped_soundfile.h"
+#include "mipmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STREAM_BLOCK_FRAMES 4096                ///< sample frames decoded at once by the reader thread <br>
+#define STREAM_WAYS 4                           ///< slots a block can be kept in, the dsp routine looks for a block in this many slots <br>
+#define STREAM_GUARD MIPMAP_GUARD               ///< samples in front of and behind every block, continue the soundfile so the kernels read a block like a table <br>
+#define STREAM_FADE_SAMPLES 256                 ///< a grain that will reach a block that is not loaded within this many samples fades out before it gets there <br>
+#define STREAM_DEFAULT_CACHE_MB 16              ///< default size of the block cache in megabytes <br>
+
+/**
+ * @struct stream_block
+ * @brief one slot of the block cache
+ */
+typedef struct stream_block
+{
+    atomic_int  index;                          ///< block of the soundfile held by the slot, -1 while it is empty or being loaded <br>
+    atomic_uint last_read;                      ///< value of @a reading when the dsp routine last found the block <br>
+    float       *samples;                       ///< first sample of the block, with @a STREAM_GUARD guard samples on both sides <br>
+} stream_block;
+
+/**
+ * @struct sample_stream
+ * @brief a soundfile decoded block by block around the region the grains read
+ * @details the dsp routine publishes the window of blocks it is going to read, a reader thread decodes them from the mapped file into a cache of fixed size.
+ * Block @a b is kept in one of the @a STREAM_WAYS slots of set @a b modulo the number of sets, so the dsp routine finds a block with a few atomic loads and never waits.
+ * The reader replaces the block of a set that was read the longest time ago and is outside of the window, so grains still playing an earlier region keep their blocks as long as possible.
+ * A slot is only overwritten once the dsp block that may still read it has ended <br>
+ */
+typedef struct sample_stream
+{
+    const mapped_soundfile *file;               ///< file the blocks are decoded from <br>
+    int         channel,                        ///< channel of the file that is played <br>
+                length,                         ///< length of the soundfile in samples <br>
+                num_blocks,                     ///< number of blocks of the soundfile <br>
+                num_slots,                      ///< number of blocks the cache holds, a multiple of @a STREAM_WAYS <br>
+                num_sets;                       ///< number of sets of @a STREAM_WAYS slots <br>
+    fixed_position wrap;                        ///< read positions wrap around at this value, soundfile length - 1 <br>
+    stream_block *slots;                        ///< the block cache <br>
+    atomic_llong window;                        ///< first block of the window the dsp routine reads in the upper, number of blocks in the lower 32 bits <br>
+    atomic_uint reading;                        ///< odd while a dsp block reads the cache, counts the dsp blocks <br>
+    purple_worker worker;                       ///< thread decoding the blocks of the window <br>
+} sample_stream;
+
+size_t sample_stream_arena_size(int length, size_t cache_bytes);
+sample_stream *sample_stream_new(purple_arena *arena, const mapped_soundfile *file, int channel, size_t cache_bytes);
+void sample_stream_stop(sample_stream *st);
+void sample_stream_prefetch(sample_stream *st, int first_frame, int last_frame, int start_frame);
+void sample_stream_begin_read(sample_stream *st);
+void sample_stream_end_read(sample_stream *st);
+int sample_stream_available(sample_stream *st, fixed_position position, fixed_position step, int num_samples);
+float sample_stream_read(sample_stream *st, fixed_position position, enum interpolation interpolation);
+void sample_stream_render(sample_stream *st, const grain_span *s, grain_span_kernel kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
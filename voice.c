@@ -0,0 +1,135 @@
+/**
+ * @file voice.c
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief handles the voices of the synth
+ * @details per note state of the polyphonic synth and voice allocation with voice stealing, nothing in here allocates memory <br>
+ * @version 1.0
+ * @date 2021-09-27
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#include "voice.h"
+#include "c_granular_synth.h"
+
+/**
+ * @brief initializes a silent voice
+ * @param v pointer to the voice <br>
+ * @param midi_pitch MIDI pitch/key value the voice starts with <br>
+ * @param time_stretch_factor time stretch factor of the synth <br>
+ */
+void voice_init(voice *v, int midi_pitch, float time_stretch_factor)
+{
+    v->midi_velo = 0;
+    v->current_adsr_stage_index = 0;
+    v->adsr = SILENT;
+    v->peak = 0.0;
+    v->gain = 0.0;
+    v->samples_to_next_onset = 0;
+    v->note_serial = 0;
+    voice_set_pitch(v, midi_pitch, time_stretch_factor);
+}
+
+/**
+ * @brief sets the pitch of a voice
+ * @details pitch factor is the time stretch factor scaled by @a midi_pitch, where 48 (C3) plays at the original speed <br>
+ * @param v pointer to the voice <br>
+ * @param midi_pitch MIDI pitch/key value <br>
+ * @param time_stretch_factor time stretch factor of the synth <br>
+ */
+void voice_set_pitch(voice *v, int midi_pitch, float time_stretch_factor)
+{
+    v->midi_pitch = midi_pitch;
+    v->pitch_factor = time_stretch_factor * midi_pitch / 48.0;
+}
+
+/**
+ * @brief checks whether a voice is audible
+ * @param v pointer to the voice <br>
+ * @return true while the note is held or its release has not finished <br>
+ */
+bool voice_is_sounding(voice *v)
+{
+    return v->midi_velo > 0 || v->adsr != SILENT;
+}
+
+/**
+ * @brief calculates the next ADSR value of a voice
+ * @details moves a voice whose note has been released into the release stage and calculates its ADSR value, the result is kept in @a gain <br>
+ * @param v pointer to the voice <br>
+ * @param env ADSR times shared by all voices <br>
+ * @return ADSR value of type float <br>
+ */
+float voice_next_adsr_value(voice *v, envelope *env)
+{
+    if(v->midi_velo > 0)
+    {
+        v->gain = calculate_adsr_value(env, v);
+    }
+    else
+    {
+        if(v->adsr == SILENT)
+        {
+            v->gain = 0;
+        }
+        else
+        {
+            if(v->adsr != RELEASE)
+            {
+                v->current_adsr_stage_index = 0;
+                v->adsr = RELEASE;
+            }
+            v->gain = calculate_adsr_value(env, v);
+        }
+    }
+    return v->gain;
+}
+
+/**
+ * @brief finds the voice that plays a note
+ * @param voices array of voices <br>
+ * @param num_voices number of usable voices <br>
+ * @param midi_pitch MIDI pitch/key value of the note <br>
+ * @return index of the sounding voice playing @a midi_pitch, -1 if there is none <br>
+ */
+int voice_find(voice *voices, int num_voices, int midi_pitch)
+{
+    for(int i = 0; i < num_voices; i++)
+    {
+        if(voices[i].midi_pitch == midi_pitch && voice_is_sounding(&voices[i])) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief picks a voice for a new note
+ * @details prefers a silent voice, otherwise steals the quietest voice in its release stage, otherwise the oldest held voice <br>
+ * @param voices array of voices <br>
+ * @param num_voices number of usable voices <br>
+ * @return index of the voice to use <br>
+ */
+int voice_allocate(voice *voices, int num_voices)
+{
+    int quietest = -1,
+        oldest = 0;
+    
+    for(int i = 0; i < num_voices; i++)
+    {
+        if(!voice_is_sounding(&voices[i])) return i;
+        
+        if(voices[i].midi_velo == 0)
+        {
+            if(quietest < 0 || voices[i].gain < voices[quietest].gain) quietest = i;
+        }
+        else if(voices[i].note_serial < voices[oldest].note_serial || voices[oldest].midi_velo == 0)
+        {
+            oldest = i;
+        }
+    }
+    return (quietest >= 0) ? quietest : oldest;
+}
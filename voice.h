@@ -0,0 +1,56 @@
+/**
+ * @file voice.h
+ * @author Kretschmar, Nikita 
+ * @author Philipp, Adrian 
+ * @author Strobl, Micha 
+ * @author Wennemann,Tim <br>
+ * Audiocommunication Group, Technische Universität Berlin <br>
+ * @brief header file to @a voice.c file
+ * @version 1.0
+ * @date 2021-09-27
+ */
+
+#ifndef voice_h
+#define voice_h
+
+#include "m_pd.h"
+#include "envelope.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_VOICES 16                           ///< maximum number of voices of one synth <br>
+
+/**
+ * @struct voice
+ * @brief one note of the synth
+ * @details holds the MIDI note, the pitch factor and the ADSR state of one note, all voices share the ADSR times of the synth and its soundfile <br>
+ */
+typedef struct voice
+{
+    int                 midi_pitch,                     ///< pitch/key value given by MIDI input <br>
+                        midi_velo,                      ///< velocity value given by MIDI input, 0 releases the voice <br>
+                        current_adsr_stage_index;       ///< index of the current ADSR stage <br>
+    enum adsr_stage     adsr;                           ///< current ADSR stage <br>
+    float               peak,                           ///< maximum value reached within one adsr cycle <br>
+                        gain,                           ///< ADSR value of the current sample <br>
+                        pitch_factor,                   ///< time stretch factor scaled by @a midi_pitch <br>
+                        samples_to_next_onset;          ///< samples left until the density based scheduler starts the next grain of this voice <br>
+    unsigned long       note_serial;                    ///< running number of the note-on that started the voice, the lowest number is the oldest voice <br>
+} voice;
+
+void voice_init(voice *v, int midi_pitch, float time_stretch_factor);
+void voice_set_pitch(voice *v, int midi_pitch, float time_stretch_factor);
+bool voice_is_sounding(voice *v);
+float voice_next_adsr_value(voice *v, envelope *env);
+int voice_find(voice *voices, int num_voices, int midi_pitch);
+int voice_allocate(voice *voices, int num_voices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif